@@ -0,0 +1,158 @@
+// 实时图表绘制基准 (主机运行, 不参与 NDK 构建)
+// 旧: 逐像素画横线/内存条, Bresenham 画折线; 新: SystemTools::fillSpan / drawSegment
+// 两者布局相同, 同时比对输出像素
+//
+// g++ -std=c++20 -Ofast -march=native -I bench/host bench/chartBench.cpp -o chartBench && ./chartBench
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "../freezeitVS/systemTools.hpp"
+
+namespace {
+	constexpr uint32_t COLOR_BLUE = 0xBBFF8000;
+	constexpr uint32_t COLOR_GRAY = 0x01808080;
+	constexpr int BUCKET_CNT = 32;
+	constexpr int CORE_CNT = 8;
+
+	struct chartData {
+		uint32_t usage[BUCKET_CNT][CORE_CNT];
+		uint32_t color[CORE_CNT];
+		uint32_t totalRam, availRam, totalSwap, freeSwap;
+	};
+
+	// 基线版本的 Bresenham 画线
+	void drawLineOld(uint32_t* imgBuf, const uint32_t width, const uint32_t color,
+		int x0, int y0, const int x1, const int y1) {
+		const int dx = abs(x1 - x0);
+		const int dy = abs(y1 - y0);
+		const int sx = x0 < x1 ? 1 : -1;
+		const int sy = y0 < y1 ? 1 : -1;
+		int err = (dx > dy ? dx : -dy) / 2, e2;
+
+		while (true) {
+			if (y0 == y1) {
+				for (int x = std::min(x0, x1); x <= std::max(x0, x1); x++)
+					imgBuf[width * y0 + x] = color;
+				return;
+			}
+			else if (x0 == x1) {
+				for (int y = std::min(y0, y1); y <= std::max(y0, y1); y++)
+					imgBuf[width * y + x0] = color;
+				return;
+			}
+
+			imgBuf[width * y0 + x0] = color;
+
+			e2 = err;
+			if (e2 > -dx) {
+				err -= dy;
+				x0 += sx;
+			}
+			if (e2 < dy) {
+				err += dx;
+				y0 += sy;
+			}
+		}
+	}
+
+	// 与 SystemTools::drawChart 相同的布局, isNew 选择实现
+	template<bool isNew>
+	uint32_t drawChart(const chartData& data, uint32_t* imgBuf, uint32_t height, uint32_t width) {
+		const uint32_t imgSize = SystemTools::chartImgSize(height, width);
+		const uint32_t imgHeight = height * 4 / 5;
+
+		auto hLine = [&](uint32_t* dst, const uint32_t color, const uint32_t cnt) {
+			if constexpr (isNew) SystemTools::fillSpan(dst, color, cnt);
+			else for (uint32_t x = 0; x < cnt; x++) dst[x] = color;
+			};
+
+		memset(imgBuf, 0, imgSize);
+		hLine(imgBuf + (height / 5) * width, COLOR_GRAY, width);
+		hLine(imgBuf + (height * 2 / 5) * width, COLOR_GRAY, width);
+		hLine(imgBuf + (height * 3 / 5) * width, COLOR_GRAY, width);
+
+		for (uint32_t y = 0; y < imgHeight; y++)
+			for (int i = 1; i < 10; ++i)
+				imgBuf[width * y + width * i / 10] = COLOR_GRAY;
+
+		const uint32_t memPos[6] = {
+			width * 5 / 100,
+			width * 5 / 100 + width * 4 / 10 * (data.totalRam - data.availRam) / data.totalRam,
+			width * 45 / 100,
+			width * 55 / 100,
+			width * 55 / 100 + width * 4 / 10 * (data.totalSwap - data.freeSwap) / data.totalSwap,
+			width * 95 / 100,
+		};
+		for (uint32_t y = (height * 218) >> 8; y < height; y++) {
+			uint32_t* row = imgBuf + width * y;
+			for (int barIdx = 0; barIdx < 2; barIdx++) {
+				const uint32_t begin = memPos[barIdx * 3], used = memPos[barIdx * 3 + 1], end = memPos[barIdx * 3 + 2];
+				if constexpr (isNew) {
+					SystemTools::fillSpan(row + begin, COLOR_BLUE, used - begin);
+					SystemTools::fillSpan(row + used, COLOR_GRAY, end - used);
+				}
+				else {
+					for (uint32_t x = begin; x < end; x++)
+						row[x] = x < used ? COLOR_BLUE : COLOR_GRAY;
+				}
+			}
+		}
+
+		for (int minuteIdx = 1; minuteIdx < BUCKET_CNT; minuteIdx++) {
+			for (int coreIdx = 0; coreIdx < CORE_CNT; coreIdx++) {
+				const uint32_t y0 = std::clamp((100 - data.usage[minuteIdx][coreIdx]) * imgHeight / 100, 1u, imgHeight - 1);
+				const uint32_t y1 = std::clamp((100 - data.usage[(minuteIdx + 1) & 0x1f][coreIdx]) * imgHeight / 100,
+					1u, imgHeight - 1);
+				const int x0 = width * (minuteIdx - 1) / 31;
+				const int x1 = std::min(width * minuteIdx / 31, width - 1);
+				if constexpr (isNew) SystemTools::drawSegment(imgBuf, width, data.color[coreIdx], x0, y0, x1, y1);
+				else drawLineOld(imgBuf, width, data.color[coreIdx], x0, y0, x1, y1);
+			}
+		}
+
+		hLine(imgBuf, COLOR_BLUE, width);
+		hLine(imgBuf + imgHeight * width, COLOR_BLUE, width);
+		for (uint32_t y = 0; y < imgHeight; y++) {
+			imgBuf[width * y] = COLOR_BLUE;
+			imgBuf[width * (y + 1) - 1] = COLOR_BLUE;
+		}
+		return imgSize;
+	}
+
+	template<typename F>
+	double framesPerSec(F&& func) {
+		constexpr int ROUNDS = 300;
+		const auto begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < ROUNDS; i++) func();
+		return ROUNDS / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	}
+}
+
+int main() {
+	chartData data{};
+	srand(1);
+	for (auto& bucket : data.usage)
+		for (auto& usage : bucket) usage = rand() % 101;
+	for (int i = 0; i < CORE_CNT; i++) data.color[i] = 0xFF000000 | (0x204080u * (i + 1));
+	data.totalRam = 8000, data.availRam = 3000, data.totalSwap = 4000, data.freeSwap = 1000;
+
+	// 常见屏幕的 1/2、1/4 尺寸及上限
+	constexpr uint32_t SIZES[][2] = { {540, 600}, {720, 800}, {720, 1080}, {1024, 1024} };
+	std::vector<uint32_t> imgNew(1 << 20), imgOld(1 << 20);
+	for (const auto& [height, width] : SIZES) {
+		const uint32_t pixelCnt = drawChart<true>(data, imgNew.data(), height, width) / 4;
+		drawChart<false>(data, imgOld.data(), height, width);
+		size_t diffCnt = 0;
+		for (uint32_t i = 0; i < pixelCnt; i++) diffCnt += imgNew[i] != imgOld[i];
+
+		const double fpsNew = framesPerSec([&] { drawChart<true>(data, imgNew.data(), height, width); });
+		const double fpsOld = framesPerSec([&] { drawChart<false>(data, imgOld.data(), height, width); });
+		printf("%4ux%-4u  new %7.0f fps  old %7.0f fps  diff %zu/%u px\n",
+			height, width, fpsNew, fpsOld, diffCnt, pixelCnt);
+	}
+	return 0;
+}
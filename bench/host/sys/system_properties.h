@@ -0,0 +1,4 @@
+#pragma once
+
+// 主机编译基准程序用, 基准程序不会调用
+extern "C" int __system_property_get(const char* name, char* value);
@@ -0,0 +1,176 @@
+// 启动时读取 packages.list / appcfg.txt / applabel.txt 的基准 (主机运行, 不参与 NDK 构建)
+// 旧: ifstream + getline + sscanf/splitString; 新: LineScan 映射整个文件按行解析
+// 在临时目录生成 600 款应用的文件, 同时比对两者的解析结果
+//
+// g++ -std=c++20 -O2 -I bench/host bench/loaderBench.cpp -o loaderBench && ./loaderBench
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "../freezeitVS/lineScan.hpp"
+
+namespace {
+	constexpr int APP_CNT = 600;
+	constexpr int ROUNDS = 200;
+
+	string packagesPath, cfgPath, labelPath;
+
+	void writeFiles(const string& dir) {
+		packagesPath = dir + "/packages.list";
+		cfgPath = dir + "/appcfg.txt";
+		labelPath = dir + "/applabel.txt";
+
+		string packages, cfg, label;
+		for (int i = 0; i < APP_CNT; i++) {
+			const string package = "com.vendor" + to_string(i) + ".app.module" + to_string(i);
+			packages += package + " " + to_string(10000 + i * 3) + " 0 /data/user/0/" + package +
+				" default:targetSdkVersion=33 3003,3002 0 " + to_string(10 + i) + " 1" +
+				(i % 3 ? "\n" : " @system\n");
+			cfg += package + " " + to_string((i % 3 + 1) * 10) + " " + to_string(i & 1) + "\n";
+			label += package + "####应用" + to_string(i) + "\n";
+		}
+		std::ofstream(packagesPath) << packages;
+		std::ofstream(cfgPath) << cfg;
+		std::ofstream(labelPath) << label;
+	}
+
+	// 基线版本 ****************************
+
+	bool packagesOld(map<int, string>& allApp, map<int, string>& thirdApp) {
+		stringstream ss;
+		ss << ifstream(packagesPath).rdbuf();
+
+		string line;
+		while (getline(ss, line)) {
+			if (line.length() < 10) continue;
+
+			int uid;
+			char package[256] = {};
+			sscanf(line.c_str(), "%s %d", package, &uid);
+			if (uid < 10000 || 12000 <= uid) continue;
+
+			allApp[uid] = package;
+			if (!line.ends_with("@system")) thirdApp[uid] = package;
+		}
+		return allApp.size();
+	}
+
+	int cfgOld() {
+		ifstream file(cfgPath);
+		string line;
+		int sum = 0;
+		while (getline(file, line)) {
+			const auto value = Utils::splitString(line, " ");
+			if (value.size() != 3) continue;
+			sum += atoi(value[1].c_str()) + atoi(value[2].c_str());
+		}
+		return sum;
+	}
+
+	size_t labelOld() {
+		ifstream file(labelPath);
+		string line;
+		size_t sum = 0;
+		while (getline(file, line)) {
+			const auto value = Utils::splitString(line, "####");
+			if (value.size() == 2) sum += value[1].length();
+		}
+		return sum;
+	}
+
+	// 当前版本, 解析方式同 ManagedApp *****
+
+	bool packagesNew(map<int, string>& allApp, map<int, string>& thirdApp) {
+		const LineScan::mappedFile file(packagesPath.c_str());
+		if (!file) return false;
+
+		file.forEachLine([&](const string_view line) {
+			if (line.length() < 10) return;
+
+			string_view rest = line;
+			const string_view package = LineScan::nextField(rest, ' ');
+			int uid;
+			if (!LineScan::parseInt(LineScan::nextField(rest, ' '), uid)) return;
+			if (uid < 10000 || 12000 <= uid) return;
+
+			auto& name = allApp[uid];
+			name = package;
+			if (!line.ends_with("@system")) thirdApp[uid] = name;
+			});
+		return allApp.size();
+	}
+
+	int cfgNew() {
+		const LineScan::mappedFile file(cfgPath.c_str());
+		int sum = 0;
+		file.forEachLine([&](const string_view line) {
+			string_view rest = line;
+			const string_view key = LineScan::nextField(rest, ' ');
+			int mode, tolerant;
+			if (key.empty() || !LineScan::parseInt(LineScan::nextField(rest, ' '), mode) ||
+				!LineScan::parseInt(LineScan::nextField(rest, ' '), tolerant))
+				return;
+			sum += mode + tolerant;
+			});
+		return sum;
+	}
+
+	size_t labelNew() {
+		constexpr string_view LABEL_DELIM("####");
+		const LineScan::mappedFile file(labelPath.c_str());
+		size_t sum = 0;
+		file.forEachLine([&](const string_view line) {
+			const size_t delimIdx = line.find(LABEL_DELIM);
+			if (delimIdx != string_view::npos) sum += line.length() - delimIdx - LABEL_DELIM.length();
+			});
+		return sum;
+	}
+
+	// *************************************
+
+	uint64_t nowNs() {
+		timespec ts{};
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1'000'000'000ULL + ts.tv_nsec;
+	}
+
+	// 取最快一次, 微秒
+	template<typename F>
+	double bestUs(F&& func) {
+		uint64_t best = UINT64_MAX;
+		for (int i = 0; i < ROUNDS; i++) {
+			const uint64_t begin = nowNs();
+			func();
+			best = std::min(best, nowNs() - begin);
+		}
+		return best / 1000.0;
+	}
+}
+
+int main() {
+	char dir[] = "/tmp/loaderBench.XXXXXX";
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	writeFiles(dir);
+
+	map<int, string> allOld, thirdOld, allNew, thirdNew;
+	packagesOld(allOld, thirdOld);
+	packagesNew(allNew, thirdNew);
+	const bool isSame = allOld == allNew && thirdOld == thirdNew && cfgOld() == cfgNew() && labelOld() == labelNew();
+	printf("%d 款应用, 解析结果%s\n", APP_CNT, isSame ? "一致" : "不一致");
+
+	printf("packages.list  old %6.1f us  new %6.1f us\n",
+		bestUs([] { map<int, string> all, third; packagesOld(all, third); }),
+		bestUs([] { map<int, string> all, third; packagesNew(all, third); }));
+	printf("appcfg.txt     old %6.1f us  new %6.1f us\n", bestUs(cfgOld), bestUs(cfgNew));
+	printf("applabel.txt   old %6.1f us  new %6.1f us\n", bestUs(labelOld), bestUs(labelNew));
+
+	unlink(packagesPath.c_str());
+	unlink(cfgPath.c_str());
+	unlink(labelPath.c_str());
+	rmdir(dir);
+	return isSame ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "utils.hpp"
+
+// 按尺寸分级的缓冲池, 缓冲区按需映射(mmap), 未写入的页不占物理内存
+// 归还后保留在空闲列表复用, 空闲超过 TRIM_IDLE_SEC 秒则 madvise(MADV_DONTNEED) 归还物理内存, 保留虚拟地址
+namespace BufferPool {
+	enum OWNER : uint8_t {
+		OWNER_SERVER,
+		OWNER_FREEZER,
+		OWNER_MANAGED_APP,
+		OWNER_OTHER,
+		OWNER_CNT,
+	};
+	inline const char* ownerName[OWNER_CNT] = { "通信服务", "冻结调度", "应用管理", "其他" };
+
+	constexpr int MIN_SHIFT = 12; // 4 KiB
+	constexpr int MAX_SHIFT = 24; // 16 MiB, 更大的直接映射, 归还即解除映射
+	constexpr int CLASS_CNT = MAX_SHIFT - MIN_SHIFT + 1;
+	constexpr uint8_t CLASS_HUGE = 0xFF;
+	constexpr size_t IDLE_MAX_PER_CLASS = 4;
+	constexpr int TRIM_IDLE_SEC = 10;
+
+	struct idleBuffer {
+		char* ptr;
+		time_t releaseTime;
+		bool isResident; // 尚未 MADV_DONTNEED
+	};
+
+	inline mutex poolMutex;
+	inline vector<idleBuffer> idleList[CLASS_CNT];
+	inline atomic<size_t> inUseBytes[OWNER_CNT]{};
+	inline atomic<size_t> mappedBytes{ 0 };
+	inline atomic<uint64_t> trimBytesTotal{ 0 };
+
+	inline uint8_t sizeClass(const size_t size) {
+		int shift = MIN_SHIFT;
+		while (shift <= MAX_SHIFT && (size_t{ 1 } << shift) < size) shift++;
+		return shift > MAX_SHIFT ? CLASS_HUGE : static_cast<uint8_t>(shift - MIN_SHIFT);
+	}
+
+	inline size_t classSize(const uint8_t cls) { return size_t{ 1 } << (cls + MIN_SHIFT); }
+
+	inline char* mapBuffer(const size_t size) {
+		void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED) {
+			fprintf(stderr, "BufferPool mmap %zu 失败 [%d]:[%s]", size, errno, strerror(errno));
+			return nullptr;
+		}
+		mappedBytes += size;
+		return static_cast<char*>(ptr);
+	}
+
+	inline void unmapBuffer(char* ptr, const size_t size) {
+		munmap(ptr, size);
+		mappedBytes -= size;
+	}
+
+	// 独占的缓冲区, 析构时归还
+	class buffer {
+	private:
+		char* ptr = nullptr;
+		size_t capacity = 0;
+		uint8_t cls = 0;
+		OWNER owner = OWNER_OTHER;
+
+	public:
+		buffer() = default;
+		buffer(char* _ptr, const size_t _capacity, const uint8_t _cls, const OWNER _owner) :
+			ptr(_ptr), capacity(_capacity), cls(_cls), owner(_owner) {}
+
+		buffer(const buffer&) = delete;
+		buffer& operator=(const buffer&) = delete;
+
+		buffer(buffer&& other) noexcept :
+			ptr(other.ptr), capacity(other.capacity), cls(other.cls), owner(other.owner) {
+			other.ptr = nullptr;
+		}
+
+		buffer& operator=(buffer&& other) noexcept {
+			if (this != &other) {
+				release();
+				ptr = other.ptr;
+				capacity = other.capacity;
+				cls = other.cls;
+				owner = other.owner;
+				other.ptr = nullptr;
+			}
+			return *this;
+		}
+
+		~buffer() { release(); }
+
+		char* data() const { return ptr; }
+		size_t size() const { return capacity; }
+		explicit operator bool() const { return ptr != nullptr; }
+
+		void release() {
+			if (!ptr) return;
+
+			inUseBytes[owner] -= capacity;
+			if (cls == CLASS_HUGE) {
+				unmapBuffer(ptr, capacity);
+			}
+			else {
+				lock_guard<mutex> lock(poolMutex);
+				auto& idle = idleList[cls];
+				if (idle.size() < IDLE_MAX_PER_CLASS)
+					idle.emplace_back(idleBuffer{ ptr, time(nullptr), true });
+				else
+					unmapBuffer(ptr, capacity);
+			}
+			ptr = nullptr;
+		}
+	};
+
+	// 取得至少 size 字节的缓冲区, 内容未初始化(新映射或已归还物理内存的为全0); 失败时 data() 为 nullptr
+	inline buffer acquire(const size_t size, const OWNER owner) {
+		const uint8_t cls = sizeClass(size);
+		const size_t capacity = cls == CLASS_HUGE ? size : classSize(cls);
+
+		char* ptr = nullptr;
+		if (cls != CLASS_HUGE) {
+			lock_guard<mutex> lock(poolMutex);
+			auto& idle = idleList[cls];
+			if (!idle.empty()) {
+				ptr = idle.back().ptr; // 后进先出, 优先复用仍驻留的
+				idle.pop_back();
+			}
+		}
+		if (!ptr) ptr = mapBuffer(capacity);
+		if (!ptr) return {};
+
+		inUseBytes[owner] += capacity;
+		return buffer(ptr, capacity, cls, owner);
+	}
+
+	// 周期调用, 归还空闲过久的缓冲区的物理内存
+	inline void trim() {
+		const time_t now = time(nullptr);
+		lock_guard<mutex> lock(poolMutex);
+		for (int cls = 0; cls < CLASS_CNT; cls++) {
+			for (auto& idle : idleList[cls]) {
+				if (!idle.isResident || now - idle.releaseTime < TRIM_IDLE_SEC) continue;
+				madvise(idle.ptr, classSize(cls), MADV_DONTNEED);
+				idle.isResident = false;
+				trimBytesTotal += classSize(cls);
+			}
+		}
+	}
+
+	inline size_t formatStats(char* buf, const size_t maxLen) {
+		size_t len = snprintf(buf, maxLen, "缓冲池 已映射 %zu KiB, 累计归还 %llu KiB\n",
+			mappedBytes.load() >> 10, (unsigned long long)(trimBytesTotal.load() >> 10));
+		for (int owner = 0; owner < OWNER_CNT && len < maxLen; owner++)
+			len += snprintf(buf + len, maxLen - len, "  %s 使用中 %zu KiB\n", ownerName[owner],
+				inUseBytes[owner].load() >> 10);
+
+		size_t residentBytes = 0, trimmedBytes = 0;
+		{
+			lock_guard<mutex> lock(poolMutex);
+			for (int cls = 0; cls < CLASS_CNT; cls++) {
+				for (const auto& idle : idleList[cls])
+					(idle.isResident ? residentBytes : trimmedBytes) += classSize(cls);
+			}
+		}
+		if (len < maxLen)
+			len += snprintf(buf + len, maxLen - len, "  空闲 待归还 %zu KiB, 已归还 %zu KiB\n",
+				residentBytes >> 10, trimmedBytes >> 10);
+		return std::min(len, maxLen);
+	}
+}
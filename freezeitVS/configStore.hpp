@@ -0,0 +1,396 @@
+#pragma once
+
+#include "utils.hpp"
+#include "freezeit.hpp"
+#include "lineScan.hpp"
+
+// 配置库: 设置、应用配置、应用名称 统一按 (分区, 键) -> 值 存储
+// config.snap    快照: 文件头 + 全部记录, 整体校验
+// config.journal 日志: 文件头 + 追加的变更记录, 每条单独校验, 末尾残缺的记录在加载时截掉
+// 两者文件头的代数相同时, 加载 = 快照 + 按序重放日志; 不同则说明日志已并入快照
+// 日志过大时由后台线程压缩: 写临时文件 -> fsync -> rename 生成新快照(代数+1), 再以同样方式换新日志
+class ConfigStore {
+public:
+	enum SECTION : uint8_t {
+		SECTION_SETTINGS,  // 键: 设置项序号(1字节)  值: 1字节
+		SECTION_APP_CFG,   // 键: 包名  值: [冻结模式, 宽容]
+		SECTION_APP_LABEL, // 键: 包名  值: 名称
+		SECTION_CNT,
+	};
+
+	using sectionMap = map<string, string, std::less<>>;
+
+private:
+	constexpr static uint32_t SNAP_MAGIC = 0x50414E53;    // "SNAP"
+	constexpr static uint32_t JOURNAL_MAGIC = 0x4C4E524A; // "JRNL"
+	constexpr static uint16_t FORMAT_VERSION = 1;
+	constexpr static size_t COMPACT_MIN_BYTES = 16 * 1024; // 日志超过此值且超过快照大小时压缩
+
+	enum OP : uint8_t {
+		OP_PUT = 1,
+		OP_ERASE = 2,
+	};
+
+	struct fileHeader {
+		uint32_t magic;
+		uint16_t version;
+		uint16_t reserved;
+		uint64_t generation;
+		uint32_t bodyLen;   // 快照: 记录区长度  日志: 0
+		uint32_t bodyCrc;   // 快照: 记录区 crc32c  日志: 0
+		uint32_t padding;
+		uint32_t headerCrc; // 以上字段的 crc32c
+	};
+	static_assert(sizeof(fileHeader) == 32);
+
+	// 记录: [crc32c:4][payloadLen:2][payload]  crc 覆盖 payloadLen 及 payload
+	// payload: [op:1][section:1][keyLen:1][key][value]
+	constexpr static size_t RECORD_HEAD_LEN = 6;
+	constexpr static size_t PAYLOAD_HEAD_LEN = 3;
+	constexpr static size_t KEY_MAX_LEN = UINT8_MAX;
+	constexpr static size_t PAYLOAD_MAX_LEN = UINT16_MAX;
+
+	Freezeit& freezeit;
+	string snapPath;
+	string journalPath;
+
+	mutex storeMutex;
+	sectionMap sections[SECTION_CNT];
+	uint64_t generation = 0;
+	int journalFd = -1;
+	size_t journalBytes = 0;
+	size_t snapBytes = 0;
+	bool isNewStore = false;
+
+	std::condition_variable compactCv;
+	bool isCompactPending = false;
+
+	static uint32_t headerCrc(const fileHeader& header) {
+		return Utils::crc32c(&header, offsetof(fileHeader, headerCrc));
+	}
+
+	static fileHeader makeHeader(const uint32_t magic, const uint64_t gen, const string_view body) {
+		fileHeader header{ magic, FORMAT_VERSION, 0, gen, static_cast<uint32_t>(body.length()),
+			body.empty() ? 0 : Utils::crc32c(body.data(), body.length()), 0, 0 };
+		header.headerCrc = headerCrc(header);
+		return header;
+	}
+
+	static bool isValidHeader(const fileHeader& header, const uint32_t magic) {
+		return header.magic == magic && header.version == FORMAT_VERSION && header.headerCrc == headerCrc(header);
+	}
+
+	static bool isValidRecord(const string_view key, const string_view value) {
+		return key.length() && key.length() <= KEY_MAX_LEN &&
+			PAYLOAD_HEAD_LEN + key.length() + value.length() <= PAYLOAD_MAX_LEN;
+	}
+
+	static void appendRecord(string& buf, const OP op, const SECTION section, const string_view key,
+		const string_view value) {
+		const uint16_t payloadLen = static_cast<uint16_t>(PAYLOAD_HEAD_LEN + key.length() + value.length());
+		const size_t begin = buf.length();
+		buf.resize(begin + RECORD_HEAD_LEN);
+		memcpy(buf.data() + begin + 4, &payloadLen, sizeof(payloadLen));
+		buf += static_cast<char>(op);
+		buf += static_cast<char>(section);
+		buf += static_cast<char>(key.length());
+		buf.append(key).append(value);
+
+		const uint32_t crc = Utils::crc32c(buf.data() + begin + 4, sizeof(payloadLen) + payloadLen);
+		memcpy(buf.data() + begin, &crc, sizeof(crc));
+	}
+
+	// 按序应用记录, 遇到残缺或校验失败的记录即停止, 返回有效部分的长度
+	size_t applyRecords(const char* data, const size_t len) {
+		size_t offset = 0;
+		while (len - offset >= RECORD_HEAD_LEN) {
+			uint32_t crc;
+			uint16_t payloadLen;
+			memcpy(&crc, data + offset, sizeof(crc));
+			memcpy(&payloadLen, data + offset + 4, sizeof(payloadLen));
+			if (payloadLen < PAYLOAD_HEAD_LEN || len - offset - RECORD_HEAD_LEN < payloadLen) break;
+			if (crc != Utils::crc32c(data + offset + 4, sizeof(payloadLen) + payloadLen)) break;
+
+			const char* payload = data + offset + RECORD_HEAD_LEN;
+			const uint8_t op = payload[0];
+			const uint8_t section = payload[1];
+			const uint8_t keyLen = payload[2];
+			if (section >= SECTION_CNT || PAYLOAD_HEAD_LEN + keyLen > payloadLen) break;
+
+			const string_view key(payload + PAYLOAD_HEAD_LEN, keyLen);
+			const string_view value(payload + PAYLOAD_HEAD_LEN + keyLen, payloadLen - PAYLOAD_HEAD_LEN - keyLen);
+			if (op == OP_PUT) {
+				sections[section].insert_or_assign(string(key), string(value));
+			}
+			else if (op == OP_ERASE) {
+				auto it = sections[section].find(key);
+				if (it != sections[section].end()) sections[section].erase(it);
+			}
+			else break;
+
+			offset += RECORD_HEAD_LEN + payloadLen;
+		}
+		return offset;
+	}
+
+	static bool writeAll(const int fd, const char* data, size_t len) {
+		while (len) {
+			const ssize_t writeLen = write(fd, data, len);
+			if (writeLen < 0) {
+				if (errno == EINTR) continue;
+				return false;
+			}
+			data += writeLen;
+			len -= writeLen;
+		}
+		return true;
+	}
+
+	void syncDir() {
+		const int dirFd = open(freezeit.modulePath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dirFd < 0) return;
+		fsync(dirFd);
+		close(dirFd);
+	}
+
+	// 写临时文件, fsync 后改名覆盖, 任何时刻 path 要么是旧内容, 要么是完整的新内容
+	bool writeFileAtomic(const string& path, const string_view header, const string_view body) {
+		const string tmpPath = path + ".tmp";
+		const int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+		if (fd < 0) {
+			freezeit.log("配置库 创建 [%s] 失败 [%d]:[%s]", tmpPath.c_str(), errno, strerror(errno));
+			return false;
+		}
+		const bool isOk = writeAll(fd, header.data(), header.length()) &&
+			writeAll(fd, body.data(), body.length()) && fsync(fd) == 0;
+		const int err = errno;
+		close(fd);
+		if (!isOk || rename(tmpPath.c_str(), path.c_str())) {
+			freezeit.log("配置库 写入 [%s] 失败 [%d]:[%s]", path.c_str(), isOk ? errno : err,
+				strerror(isOk ? errno : err));
+			unlink(tmpPath.c_str());
+			return false;
+		}
+		syncDir();
+		return true;
+	}
+
+	// 以下需持有 storeMutex *****************
+
+	bool createJournal() {
+		if (journalFd >= 0) close(journalFd);
+		journalFd = -1;
+		journalBytes = 0;
+
+		const fileHeader header = makeHeader(JOURNAL_MAGIC, generation, {});
+		if (!writeFileAtomic(journalPath, { reinterpret_cast<const char*>(&header), sizeof(header) }, {}))
+			return false;
+
+		journalFd = open(journalPath.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+		if (journalFd < 0) {
+			freezeit.log("配置库 打开日志失败 [%d]:[%s]", errno, strerror(errno));
+			return false;
+		}
+		journalBytes = sizeof(header);
+		return true;
+	}
+
+	// 全部记录写入新快照, 再换新日志; 日志不可用时每次修改都走这里
+	bool compact() {
+		TRACE_SCOPE;
+
+		string body;
+		for (int section = 0; section < SECTION_CNT; section++)
+			for (const auto& [key, value] : sections[section])
+				appendRecord(body, OP_PUT, static_cast<SECTION>(section), key, value);
+
+		const fileHeader header = makeHeader(SNAP_MAGIC, generation + 1, body);
+		if (!writeFileAtomic(snapPath, { reinterpret_cast<const char*>(&header), sizeof(header) }, body))
+			return false;
+
+		generation++;
+		snapBytes = sizeof(header) + body.length();
+		createJournal(); // 失败时旧日志代数不符, 加载时会被忽略
+		return true;
+	}
+
+	// 内存中的分区须已更新: 日志不可用时改写快照
+	// 写入失败时内存中的修改保留, 由后台压缩重试写入
+	bool append(const string& records) {
+		if (records.empty()) return true;
+		if (journalFd < 0) return compact();
+
+		if (!writeAll(journalFd, records.data(), records.length()) || fdatasync(journalFd)) {
+			freezeit.log("配置库 写入日志失败 [%d]:[%s]", errno, strerror(errno));
+			if (ftruncate(journalFd, journalBytes)) { // 去掉写了一半的记录, 否则其后的记录无法重放
+				close(journalFd);
+				journalFd = -1;
+			}
+			isCompactPending = true;
+			compactCv.notify_one();
+			return false;
+		}
+
+		journalBytes += records.length();
+		if (journalBytes > std::max(COMPACT_MIN_BYTES, snapBytes)) {
+			isCompactPending = true;
+			compactCv.notify_one();
+		}
+		return true;
+	}
+
+	// *****************************************
+
+	void load() {
+		bool isSnapBad = false;
+		{
+			const LineScan::mappedFile snapFile(snapPath.c_str());
+			if (!snapFile) {
+				isNewStore = true;
+				return;
+			}
+
+			const string_view snap = snapFile.view();
+			fileHeader header{};
+			if (snap.length() >= sizeof(header))
+				memcpy(&header, snap.data(), sizeof(header));
+			const string_view body = snap.substr(std::min(snap.length(), sizeof(header)));
+			if (!isValidHeader(header, SNAP_MAGIC) || body.length() != header.bodyLen ||
+				Utils::crc32c(body.data(), body.length()) != header.bodyCrc ||
+				applyRecords(body.data(), body.length()) != body.length()) {
+				for (auto& section : sections) section.clear();
+				isSnapBad = true;
+			}
+			else {
+				generation = header.generation;
+				snapBytes = snap.length();
+			}
+		}
+		if (isSnapBad)
+			rename(snapPath.c_str(), (snapPath + ".bad").c_str());
+
+		size_t fileBytes = 0;
+		{
+			const LineScan::mappedFile journalFile(journalPath.c_str());
+			const string_view journal = journalFile ? journalFile.view() : string_view();
+			fileHeader header{};
+			if (journal.length() >= sizeof(header))
+				memcpy(&header, journal.data(), sizeof(header));
+			// 快照损坏时无从比对代数, 日志有效即在默认值上重放, 比旧版配置文件更接近丢失前的配置
+			if (isValidHeader(header, JOURNAL_MAGIC) && (isSnapBad || header.generation == generation)) {
+				if (isSnapBad) generation = header.generation;
+				fileBytes = journal.length();
+				journalBytes = sizeof(header) +
+					applyRecords(journal.data() + sizeof(header), journal.length() - sizeof(header));
+			}
+		}
+
+		if (isSnapBad) {
+			const size_t recordBytes = journalBytes ? journalBytes - sizeof(fileHeader) : 0;
+			freezeit.log("❗配置库快照损坏, 已另存为 config.snap.bad, 配置已丢失: 仅恢复日志中 %zu 字节的修改, "
+				"其余设置、应用配置及名称为默认值, 请重新设置", recordBytes);
+			journalBytes = 0;
+			lock_guard<mutex> lock(storeMutex);
+			compact(); // 以恢复的内容建立新快照与日志
+			return;
+		}
+
+		if (journalBytes == 0) {
+			createJournal();
+			return;
+		}
+
+		journalFd = open(journalPath.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+		if (journalFd < 0) {
+			freezeit.log("配置库 打开日志失败 [%d]:[%s]", errno, strerror(errno));
+			return;
+		}
+		if (journalBytes < fileBytes) {
+			freezeit.log("配置库日志末尾 %zu 字节残缺, 已丢弃", fileBytes - journalBytes);
+			if (ftruncate(journalFd, journalBytes)) {
+				close(journalFd);
+				journalFd = -1;
+			}
+		}
+		isCompactPending = journalBytes > std::max(COMPACT_MIN_BYTES, snapBytes);
+	}
+
+	void compactTask() {
+		Trace::setThreadName("cfgstore");
+
+		while (true) {
+			std::unique_lock<mutex> lock(storeMutex);
+			compactCv.wait(lock, [this] { return isCompactPending; });
+			isCompactPending = false;
+			compact();
+		}
+	}
+
+public:
+	ConfigStore& operator=(ConfigStore&&) = delete;
+
+	ConfigStore(Freezeit& freezeit) : freezeit(freezeit) {
+		snapPath = freezeit.modulePath + "/config.snap";
+		journalPath = freezeit.modulePath + "/config.journal";
+
+		load();
+		if (isNewStore) {
+			lock_guard<mutex> lock(storeMutex);
+			compact(); // 建立空的快照与日志, 迁移的内容随后追加
+		}
+
+		thread(&ConfigStore::compactTask, this).detach();
+	}
+
+	// 首次运行, 还没有配置库, 各模块需从旧版配置文件迁移
+	// 快照损坏不算: 旧版配置文件早已过时, 此时以默认值加日志中的修改为准
+	bool isNew() const { return isNewStore; }
+
+	// 按键升序遍历分区 func(string_view key, string_view value)
+	template<typename F>
+	void forEach(const SECTION section, F&& func) {
+		lock_guard<mutex> lock(storeMutex);
+		for (const auto& [key, value] : sections[section])
+			func(string_view(key), string_view(value));
+	}
+
+	bool put(const SECTION section, const string_view key, const string_view value) {
+		if (!isValidRecord(key, value)) {
+			freezeit.log("配置库 键值过长, 已忽略 [%.*s]", static_cast<int>(key.length()), key.data());
+			return false;
+		}
+
+		lock_guard<mutex> lock(storeMutex);
+		auto it = sections[section].find(key);
+		if (it != sections[section].end() && it->second == value) return true;
+
+		string records;
+		appendRecord(records, OP_PUT, section, key, value);
+		sections[section].insert_or_assign(string(key), string(value));
+		return append(records);
+	}
+
+	// 以 newSection 替换整个分区, 只把有变化的键作为一次追加写入日志
+	bool replaceSection(const SECTION section, sectionMap newSection) {
+		std::erase_if(newSection, [this](const auto& item) {
+			if (isValidRecord(item.first, item.second)) return false;
+			freezeit.log("配置库 键值过长, 已忽略 [%s]", item.first.c_str());
+			return true;
+			});
+
+		lock_guard<mutex> lock(storeMutex);
+		auto& curSection = sections[section];
+
+		string records;
+		for (const auto& [key, value] : curSection)
+			if (!newSection.contains(key))
+				appendRecord(records, OP_ERASE, section, key, {});
+		for (const auto& [key, value] : newSection) {
+			auto it = curSection.find(key);
+			if (it == curSection.end() || it->second != value)
+				appendRecord(records, OP_PUT, section, key, value);
+		}
+		curSection = std::move(newSection);
+		return append(records);
+	}
+};
@@ -17,8 +17,9 @@ private:
 	uint32_t enterDozeCycleStamp = 0;
 	time_t lastInteractiveTime = time(nullptr); // 上次检查为 亮屏或充电 的时间戳
 
+	// 不可持有 lockAppList(): 只在读应用表、生成命令时持锁, dumpsys 在锁外执行
 	void updateDozeWhitelist() {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
 		const char* cmdList[] = { "/system/bin/dumpsys", "dumpsys", "deviceidle", "whitelist",
 								 nullptr };
@@ -28,9 +29,11 @@ private:
 		stringstream ss;
 		ss << buf;
 
-		string tmp, tmpLabel, line;
+		string removeCmd, removeLabel, addCmd, addLabel, existLabel, line;
 		set<int> existSet;
 
+		auto appListLock = managedApp.lockAppList();
+
 		// https://cs.android.com/android/platform/superproject/+/android-12.1.0_r27:frameworks/base/apex/jobscheduler/service/java/com/android/server/DeviceIdleController.java;l=485
 		// "system-excidle,xxx,uid"  该名单在Doze模式会失效
 		// "system,xxx,uid"
@@ -45,62 +48,58 @@ private:
 
 			auto& info = managedApp.getRaw()[uid];
 			if (info.freezeMode < FREEZE_MODE::WHITELIST) {
-				tmp += "dumpsys deviceidle whitelist -" + info.package + ";";
-				tmpLabel += info.label + " ";
+				removeCmd += "dumpsys deviceidle whitelist -" + info.package + ";";
+				removeLabel += info.label + " ";
 			}
 			else
 				existSet.insert(uid);
 		}
 
-		if (tmp.length()) {
-			freezeit.log("移除电池优化白名单: %s", tmpLabel.c_str());
-			system(tmp.c_str());
-		}
-
-		tmp.clear();
-		tmpLabel.clear();
 		for (const auto& [uid, info] : managedApp.getRaw()) {
 			if (info.isSystemApp) continue;
 
 			if (info.freezeMode >= FREEZE_MODE::WHITELIST && !existSet.contains(uid)) {
-				tmp += "dumpsys deviceidle whitelist +" + info.package + ";";
-				tmpLabel += info.label + " ";
+				addCmd += "dumpsys deviceidle whitelist +" + info.package + ";";
+				addLabel += info.label + " ";
 			}
 		}
-		if (tmp.length()) {
-			freezeit.log("加入电池优化白名单: %s", tmpLabel.c_str());
-			system(tmp.c_str());
-		}
 
 		if (settings.enableScreenDebug) {
-			tmp.clear();
 			for (const auto uid : existSet)
-				tmp += managedApp[uid].label + " ";
-			if (tmp.length())
-				freezeit.log("已在白名单: %s", tmp.c_str());
+				existLabel += managedApp[uid].label + " ";
 		}
+		appListLock.unlock();
 
-		END_TIME_COUNT;
+		if (removeCmd.length()) {
+			freezeit.log("移除电池优化白名单: %s", removeLabel.c_str());
+			system(removeCmd.c_str());
+		}
+
+		if (addCmd.length()) {
+			freezeit.log("加入电池优化白名单: %s", addLabel.c_str());
+			system(addCmd.c_str());
+		}
+
+		if (existLabel.length())
+			freezeit.log("已在白名单: %s", existLabel.c_str());
 	}
 
 	// 0获取失败 1息屏 2亮屏
 	int getScreenByLocalSocket() {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
 		int buff[64];
 		int recvLen = Utils::localSocketRequest(XPOSED_CMD::GET_SCREEN, nullptr, 0, buff,
 			sizeof(buff));
 
 		if (recvLen == 0) {
-			freezeit.log("%s() 工作异常, 请确认LSPosed中冻它勾选系统框架, 然后重启", __FUNCTION__);
-			END_TIME_COUNT;
+			LOG_LIMIT(60, "%s() 工作异常, 请确认LSPosed中冻它勾选系统框架, 然后重启", __FUNCTION__);
 			return 0;
 		}
 		else if (recvLen != 4) {
 			freezeit.log("%s() 屏幕数据异常 recvLen[%d]", __FUNCTION__, recvLen);
 			if (recvLen > 0 && recvLen < 64 * 4)
 				freezeit.log("DumpHex: [%s]", Utils::bin2Hex(buff, recvLen).c_str());
-			END_TIME_COUNT;
 			return 0;
 		}
 
@@ -112,7 +111,6 @@ private:
 		}
 
 
-		END_TIME_COUNT;
 		return buff[0];
 	}
 
@@ -194,17 +192,18 @@ public:
 		updateUidTime();
 	}
 
+	// 由循环线程在未持有 lockAppList() 时调用, 读应用表时自行持锁
 	bool checkIfNeedToExit() {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 		if (!isInteractive()) {
 			if (settings.enableScreenDebug)
 				freezeit.log("Doze调试: 息屏中, 发现有活动");
 
-			END_TIME_COUNT;
 			return false;
 		}
 
 		isScreenOffStandby = false;
+		Trace::instant("dozeExit");
 
 		if (settings.enableDoze) {
 			system("dumpsys deviceidle unforce");
@@ -239,6 +238,7 @@ public:
 			};
 			vector<st> uidTimeSort;
 			uidTimeSort.reserve(32);
+			const auto appListLock = managedApp.lockAppList();
 			for (const auto& [uid, timeList] : updateUidTime()) {
 				int delta = (timeList.total - timeList.lastTotal); // 毫秒
 				if (delta <= 100)continue; // 过滤 100毫秒
@@ -262,10 +262,10 @@ public:
 			if (len)
 				freezeit.log("Doze期间应用的CPU活跃时间:\n\n%s", buf);
 		}
-		END_TIME_COUNT;
 		return true;
 	}
 
+	// 同上, dumpsys 及 200ms 等待都在锁外
 	bool checkIfNeedToEnter() {
 		constexpr int TIMEOUT = 3 * 60;
 		static int secCnt = 30;
@@ -295,12 +295,16 @@ public:
 		}
 
 		isScreenOffStandby = true;
+		Trace::instant("dozeEnter");
 
 		if (settings.enableDoze) {
 			if (settings.enableScreenDebug)
 				freezeit.log("开始准备深度Doze");
 			updateDozeWhitelist();
-			updateUidTime();
+			{
+				const auto appListLock = managedApp.lockAppList();
+				updateUidTime();
+			}
 
 			freezeit.log("😴 进入深度Doze");
 			enterDozeTimeStamp = nowTimeStamp;
@@ -316,9 +320,10 @@ public:
 
 
 	map<int, uidTimeStruct> uidTime; // ms 微秒
+	// 需持有 lockAppList(), 工作线程 getUidTime 同样读写 uidTime
 	map<int, uidTimeStruct>& updateUidTime() {
 
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
 		stringstream ss;
 		ss << ifstream("/proc/uid_cputime/show_uid_stat").rdbuf();
@@ -335,7 +340,6 @@ public:
 			}
 		}
 
-		END_TIME_COUNT;
 		return uidTime;
 	}
 };
@@ -2,19 +2,53 @@
 
 #include "utils.hpp"
 #include "vpopen.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
 
 class Freezeit {
 private:
 	const char* LOG_PATH = "/sdcard/Android/freezeit.log";
 
 	constexpr static int LINE_SIZE = 1024 * 32;   //  32 KiB
-	constexpr static int BUFF_SIZE = 1024 * 128;  // 128 KiB
+	constexpr static int BUFF_SIZE = 1024 * 128;  // 128 KiB 环形缓冲区, 须为2的幂
+	constexpr static uint64_t BUFF_MASK = BUFF_SIZE - 1;
+	static_assert((BUFF_SIZE & BUFF_MASK) == 0);
+
+	constexpr static int FILE_CACHE_SIZE = 1024 * 16;      //  16 KiB 文件日志合并写入缓存
+	constexpr static int FILE_FLUSH_INTERVAL = 10;         // 秒
+	constexpr static int REPEAT_FLUSH_INTERVAL = 5;        // 秒, 重复计数最长的未输出时间
+	constexpr static int LOG_ROTATE_CNT = 3;               // freezeit.log.1 ~ freezeit.log.3
+	constexpr static uint32_t LOG_FILE_SIZE_DEFAULT = 1024 * 1024; // 1 MiB
 
 	mutex logPrintMutex;
 	bool toFileFlag = false;
+	int logFd = -1;
+	off_t logFileSize = 0;
+	uint32_t logFileMaxSize = LOG_FILE_SIZE_DEFAULT;
+	time_t lastFlushTime = 0;
+	uint32_t lastLineHash = 0;  // 上一行文本日志的哈希(不含时间)
+	uint32_t repeatCnt = 0;     // 上一行被重复的次数
+	time_t repeatBeginTime = 0; // 首次重复的时间
+	size_t fileCacheLen = 0;
+	char fileCache[FILE_CACHE_SIZE];
 	char lineCache[LINE_SIZE] = "[00:00:00]  ";
 	char logCache[BUFF_SIZE];
-	size_t position = 0;
+	uint64_t logHead = 0;  // 最旧一行的起始序号, 始终位于行首
+	uint64_t logTail = 0;  // 下一个字节的写入序号
+
+	// 缓冲区中的条目为文本行或事件记录 eventRecord, 事件在读取时才渲染
+	struct logPiece {
+		bool isRendered; // true: renderCache 中的偏移  false: 日志序号
+		uint64_t begin;
+		size_t len;
+	};
+	string renderCache;
+	vector<logPiece> logPieces;
+	vector<iovec> logIov;
+
+	using labelHookFunc = const char* (*)(void* ctx, int uid);
+	labelHookFunc labelHook = nullptr;
+	void* labelHookCtx = nullptr;
 
 	string propPath;
 	string changelog{ "无" };
@@ -196,34 +230,260 @@ private:
 			0x91,  //特殊结束符
 	};
 
-	void toMem(const char* logStr, const int& len) {
-		if ((position + len) >= BUFF_SIZE)
-			position = 0;
+	bool isEventAt(const uint64_t seq) {
+		return logCache[seq & BUFF_MASK] == static_cast<char>(EVENT_TAG) &&
+			(logTail - seq) >= sizeof(eventRecord);
+	}
 
-		memcpy(logCache + position, logStr, len);
-		position += len;
+	void ringRead(const uint64_t seq, void* dst, const size_t len) {
+		const size_t idx = seq & BUFF_MASK;
+		const size_t firstLen = std::min(len, BUFF_SIZE - idx);
+		memcpy(dst, logCache + idx, firstLen);
+		memcpy(static_cast<char*>(dst) + firstLen, logCache, len - firstLen);
 	}
 
-	void toFile(const char* logStr, const int& len) {
-		auto fp = fopen(LOG_PATH, "ab");
-		if (!fp) {
-			fprintf(stderr, "日志输出(追加模式)失败 [%d][%s]", errno, strerror(errno));
+	// 从 seq 开始的条目长度: 事件记录为定长, 文本行至 '\n' 为止(含)
+	size_t entryLen(const uint64_t seq) {
+		if (isEventAt(seq))
+			return sizeof(eventRecord);
+
+		const size_t remain = logTail - seq;
+		const size_t idx = seq & BUFF_MASK;
+		const size_t firstLen = std::min(remain, BUFF_SIZE - idx);
+
+		auto ptr = static_cast<const char*>(memchr(logCache + idx, '\n', firstLen));
+		if (ptr) return (ptr - (logCache + idx)) + 1;
+
+		ptr = static_cast<const char*>(memchr(logCache, '\n', remain - firstLen));
+		if (ptr) return firstLen + (ptr - logCache) + 1;
+
+		return remain; // 没有完整的行
+	}
+
+	// 丢弃最旧的一个条目, 保证 logHead 始终位于行首, 读取方不会看到半行
+	void dropOldestLine() {
+		logHead += entryLen(logHead);
+	}
+
+	// "[00:00:00] " 北京时间, 共11字节
+	static void formatTimePrefix(char* buf, time_t timeStamp) {
+		timeStamp += 8 * 3600L;
+		const int hour = (timeStamp / 3600) % 24;
+		const int min = (timeStamp % 3600) / 60;
+		const int sec = timeStamp % 60;
+
+		buf[0] = '[';
+		buf[1] = (hour / 10) + '0';
+		buf[2] = (hour % 10) + '0';
+		buf[3] = ':';
+		buf[4] = (min / 10) + '0';
+		buf[5] = (min % 10) + '0';
+		buf[6] = ':';
+		buf[7] = (sec / 10) + '0';
+		buf[8] = (sec % 10) + '0';
+		buf[9] = ']';
+		buf[10] = ' ';
+	}
+
+	const char* getEventLabel(const int uid, char* tmp, const size_t maxLen) {
+		const char* label = labelHook ? labelHook(labelHookCtx, uid) : nullptr;
+		if (label) return label;
+		snprintf(tmp, maxLen, "UID:%d", uid);
+		return tmp;
+	}
+
+	// 渲染一条事件记录, 追加到 out, 以 '\n' 结尾
+	void renderEvent(const eventRecord& rec, string& out) {
+		char buf[1024];
+		char labelTmp[32];
+		formatTimePrefix(buf, rec.timestamp);
+		size_t len = 11;
+
+		auto appendDuration = [&](const int sec) {
+			if (sec >= 3600)
+				STRNCAT(buf, len, "%d时", sec / 3600);
+			if (sec >= 60)
+				STRNCAT(buf, len, "%d分", (sec % 3600) / 60);
+			STRNCAT(buf, len, "%d秒", sec % 60);
+		};
+
+		switch (rec.type) {
+		case EVENT::FREEZE:
+		case EVENT::CLOSE: {
+			const char* label = getEventLabel(rec.uid, labelTmp, sizeof(labelTmp));
+			if (rec.type == EVENT::FREEZE)
+				STRNCAT(buf, len, "%s冻结 %s %d进程 ",
+					static_cast<FREEZE_MODE>(rec.code) == FREEZE_MODE::SIGNAL ? "🧊" : "❄️",
+					label, rec.pidCnt);
+			else
+				STRNCAT(buf, len, "😭关闭 %s ", label);
+
+			STRNCAT(buf, len, "运行");
+			appendDuration(rec.duration);
+			STRNCAT(buf, len, " 累计");
+			appendDuration(rec.value);
+		} break;
+
+		case EVENT::THAW:
+			STRNCAT(buf, len, "☀️解冻 %s %d进程", getEventLabel(rec.uid, labelTmp, sizeof(labelTmp)),
+				rec.pidCnt);
+			break;
+
+		case EVENT::OPEN:
+			STRNCAT(buf, len, "😁打开 %s", getEventLabel(rec.uid, labelTmp, sizeof(labelTmp)));
+			break;
+
+		case EVENT::BINDER_DELAY: {
+			const char* label = getEventLabel(rec.uid, labelTmp, sizeof(labelTmp));
+			if (rec.duration < 60)
+				STRNCAT(buf, len, "%s:%d Binder正在传输, 延迟冻结 %d秒", label, rec.value, rec.duration);
+			else
+				STRNCAT(buf, len, "%s:%d Binder正在传输, 延迟冻结 %d分%d秒", label, rec.value,
+					rec.duration / 60, rec.duration % 60);
+		} break;
+
+		case EVENT::TIMED_THAW:
+			STRNCAT(buf, len, "☀️定时解冻 %s %d进程", getEventLabel(rec.uid, labelTmp, sizeof(labelTmp)),
+				rec.pidCnt);
+			break;
+
+		case EVENT::KILLED_BACK:
+			STRNCAT(buf, len, "🗑️后台被杀 %s", getEventLabel(rec.uid, labelTmp, sizeof(labelTmp)));
+			break;
+
+		case EVENT::REFREEZE_FREEZER:
+			STRNCAT(buf, len, "定时Freezer压制:  %s", getEventLabel(rec.uid, labelTmp, sizeof(labelTmp)));
+			break;
+
+		case EVENT::REFREEZE_SIGNAL:
+			STRNCAT(buf, len, "定时kill压制:  %s", getEventLabel(rec.uid, labelTmp, sizeof(labelTmp)));
+			break;
+
+		case EVENT::REFREEZE_KILL:
+			STRNCAT(buf, len, "定时压制 杀死后台:  %s", getEventLabel(rec.uid, labelTmp, sizeof(labelTmp)));
+			break;
+
+		case EVENT::BATTERY: {
+			const int lastCapacity = rec.uid;
+			const int nowCapacity = rec.pidCnt;
+			const int deltaMinute = rec.duration / 60;
+			const int mWatt = rec.value;
+
+			STRNCAT(buf, len, "%s到 %d%%  ", lastCapacity > nowCapacity ?
+				(deltaMinute == 1 ? "❗耗电" : "🔋放电") :
+				(mWatt > 20'000 ? "⚡快充" : "🔌充电"), nowCapacity);
+			if (deltaMinute >= 60)
+				STRNCAT(buf, len, "%d时", deltaMinute / 60);
+			STRNCAT(buf, len, "%d分钟%s了%d%%  %.2fw %.1f℃", deltaMinute % 60,
+				lastCapacity > nowCapacity ? "用" : "充", abs(lastCapacity - nowCapacity),
+				mWatt / 1e3, rec.code / 1e1);
+		} break;
+
+		default:
+			STRNCAT(buf, len, "未知事件[%d] UID:%d", static_cast<int>(rec.type), rec.uid);
+			break;
+		}
+
+		out.append(buf, std::min(len, sizeof(buf) - 1));
+		out += '\n';
+	}
+
+	static bool isRefreezeEvent(const EVENT type) {
+		return type == EVENT::REFREEZE_FREEZER || type == EVENT::REFREEZE_SIGNAL ||
+			type == EVENT::REFREEZE_KILL;
+	}
+
+	// 需持有 logPrintMutex
+	void toMem(const char* logStr, const size_t len) {
+		if (len == 0 || len > BUFF_SIZE) return;
+
+		while ((logTail + len - logHead) > BUFF_SIZE)
+			dropOldestLine();
+
+		const size_t idx = logTail & BUFF_MASK;
+		const size_t firstLen = std::min(len, BUFF_SIZE - idx);
+		memcpy(logCache + idx, logStr, firstLen);
+		memcpy(logCache, logStr + firstLen, len - firstLen);
+		logTail += len;
+		Metrics::logBytesTotal.inc(0, len);
+	}
+
+	// 文件日志先合并到缓存, 缓存满或超过刷新间隔才写入, 须持有 logPrintMutex
+	void toFile(const char* logStr, const size_t len) {
+		if (fileCacheLen + len > FILE_CACHE_SIZE)
+			flushFile();
+
+		if (len > FILE_CACHE_SIZE) {
+			writeFile(logStr, len);
 			return;
 		}
 
-		auto fileSize = ftell(fp);
-		if ((fileSize + len) >= BUFF_SIZE) {
-			fclose(fp);
-			usleep(1000);
-			fp = fopen(LOG_PATH, "wb");
-			if (!fp) {
-				fprintf(stderr, "日志输出(超额清理模式)失败 [%d][%s]", errno, strerror(errno));
+		memcpy(fileCache + fileCacheLen, logStr, len);
+		fileCacheLen += len;
+	}
+
+	void flushFile() {
+		flushRepeat(time(nullptr));
+		if (fileCacheLen == 0) return;
+		writeFile(fileCache, fileCacheLen);
+		fileCacheLen = 0;
+	}
+
+	// 常驻 O_APPEND 描述符写入, 超过大小上限则轮转为 freezeit.log.1 ~ .N
+	void writeFile(const char* data, const size_t len) {
+		lastFlushTime = time(nullptr);
+
+		if (logFd >= 0 && logFileSize > 0 && logFileSize + static_cast<off_t>(len) > logFileMaxSize)
+			rotateFile();
+
+		if (logFd < 0) {
+			logFd = open(LOG_PATH, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+			if (logFd < 0) {
+				fprintf(stderr, "日志文件打开失败 [%d][%s]", errno, strerror(errno));
 				return;
 			}
+
+			struct stat statBuf {};
+			logFileSize = fstat(logFd, &statBuf) ? 0 : statBuf.st_size;
+			if (logFileSize > 0 && logFileSize + static_cast<off_t>(len) > logFileMaxSize)
+				rotateFile();
+			if (logFd < 0) return;
 		}
 
-		fwrite(logStr, 1, len, fp);
-		fclose(fp);
+		size_t offset = 0;
+		while (offset < len) {
+			const ssize_t writeLen = write(logFd, data + offset, len - offset);
+			if (writeLen < 0 && errno == EINTR) continue;
+			if (writeLen <= 0) {
+				fprintf(stderr, "日志文件写入失败 [%d][%s]", errno, strerror(errno));
+				close(logFd);
+				logFd = -1;
+				return;
+			}
+			offset += writeLen;
+		}
+		logFileSize += len;
+		fdatasync(logFd);
+		Metrics::logBytesTotal.inc(1, len);
+	}
+
+	void rotateFile() {
+		close(logFd);
+		logFd = -1;
+
+		char src[128], dst[128];
+		for (int i = LOG_ROTATE_CNT - 1; i >= 1; i--) {
+			snprintf(src, sizeof(src), "%s.%d", LOG_PATH, i);
+			snprintf(dst, sizeof(dst), "%s.%d", LOG_PATH, i + 1);
+			rename(src, dst);
+		}
+		snprintf(dst, sizeof(dst), "%s.1", LOG_PATH);
+		rename(LOG_PATH, dst);
+
+		logFd = open(LOG_PATH, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+		logFileSize = 0;
+		if (logFd < 0)
+			fprintf(stderr, "日志文件轮转失败 [%d][%s]", errno, strerror(errno));
 	}
 
 public:
@@ -244,6 +504,13 @@ public:
 
 	uint32_t extMemorySize{ 0 };
 
+	// 日志序号所属的纪元, 每次启动不同; 客户端游标的纪元不符说明进程已重启, 序号不可比较
+	const uint64_t logEpoch = [] {
+		timespec ts{};
+		clock_gettime(CLOCK_REALTIME, &ts);
+		return (static_cast<uint64_t>(ts.tv_sec) * 1'000'000'000ULL + ts.tv_nsec) ^ (static_cast<uint64_t>(getpid()) << 48);
+		}();
+
 	Freezeit& operator=(Freezeit&&) = delete;
 
 	Freezeit(int argc, const char* exePath) {
@@ -283,13 +550,13 @@ public:
 		if (fp) {
 			auto len = fread(logCache, 1, BUFF_SIZE, fp);
 			if (len > 0)
-				position = len;
+				logTail = len;
 			fclose(fp);
 		}
 
 		toFileFlag = argc > 1;
 		if (toFileFlag) {
-			if (position)toFile(logCache, position);
+			if (logTail)toFile(logCache, logTail);
 			const char tips[] = "日志已通过文件输出: /sdcard/Android/freezeit.log";
 			toMem(tips, sizeof(tips) - 1);
 		}
@@ -348,6 +615,11 @@ public:
 
 	size_t getChangelogLen() { return changelog.length(); }
 
+	// 日志模块常驻的缓冲区: 环形缓冲 行缓冲 文件缓冲 渲染缓存
+	size_t getLogMemSize() const {
+		return sizeof(logCache) + sizeof(lineCache) + sizeof(fileCache) + renderCache.capacity();
+	}
+
 	void checkModuleProp() {
 		if (prop[string((const char*)checkInfo[3])].starts_with((const char*)checkInfo[0]) &&
 			prop[string((const char*)checkInfo[4])].starts_with((const char*)checkInfo[1]) &&
@@ -410,32 +682,58 @@ public:
 	}
 
 	void log(const char* fmt, ...) {
-		lock_guard<mutex> lock(logPrintMutex);
+		va_list args{};
+		va_start(args, fmt);
+		vlog(0, fmt, args);
+		va_end(args);
+	}
 
-		time_t timeStamp = time(nullptr) + 8 * 3600L;
-		int hour = (timeStamp / 3600) % 24;
-		int min = (timeStamp % 3600) / 60;
-		int sec = timeStamp % 60;
+	// 见 LOG_LIMIT, SITE 为调用位置键, 每个调用位置各自实例化一份计数
+	template<uint32_t SITE>
+	void logLimit(const int intervalSec, const char* fmt, ...) {
+		static atomic<time_t> lastTime{ 0 };
+		static atomic<uint32_t> suppressCnt{ 0 };
 
-		//lineCache[LINE_SIZE] = "[00:00:00]  ";
-		lineCache[1] = (hour / 10) + '0';
-		lineCache[2] = (hour % 10) + '0';
-		lineCache[4] = (min / 10) + '0';
-		lineCache[5] = (min % 10) + '0';
-		lineCache[7] = (sec / 10) + '0';
-		lineCache[8] = (sec % 10) + '0';
+		const time_t now = time(nullptr);
+		time_t last = lastTime.load(std::memory_order_relaxed);
+		if ((now - last) < intervalSec || !lastTime.compare_exchange_strong(last, now)) {
+			suppressCnt.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
 
 		va_list args{};
 		va_start(args, fmt);
-		int len = vsnprintf(lineCache + 11, (size_t)(LINE_SIZE - 11), fmt, args) + 11;
+		vlog(suppressCnt.exchange(0, std::memory_order_relaxed), fmt, args);
 		va_end(args);
+	}
+
+private:
+	void vlog(const uint32_t foldCnt, const char* fmt, va_list args) {
+		lock_guard<mutex> lock(logPrintMutex);
+
+		//lineCache[LINE_SIZE] = "[00:00:00] ";
+		const time_t now = time(nullptr);
+		formatTimePrefix(lineCache, now);
+
+		int len = vsnprintf(lineCache + 11, (size_t)(LINE_SIZE - 11), fmt, args) + 11;
 
-		if (len <= 11 || LINE_SIZE <= (len + 1)) {
+		if (len <= 11 || LINE_SIZE <= (len + 64)) {
 			lineCache[11] = 0;
 			fprintf(stderr, "日志异常: len[%d] lineCache[%s]", len, lineCache);
 			return;
 		}
 
+		// 与上一行内容相同(不含时间)则只计数
+		const uint32_t lineHash = Utils::fnv1a(lineCache + 11, len - 11);
+		if (foldCnt == 0 && lineHash == lastLineHash) {
+			if (repeatCnt++ == 0) repeatBeginTime = now;
+			return;
+		}
+		lastLineHash = lineHash;
+		flushRepeat(now);
+
+		if (foldCnt)
+			len += snprintf(lineCache + len, 64, " (已折叠%u条)", foldCnt);
 		lineCache[len++] = '\n';
 
 		if (toFileFlag)
@@ -444,16 +742,171 @@ public:
 			toMem(lineCache, len);
 	}
 
+	// "上条日志重复 N 次" 行, 返回长度, buf 至少64字节
+	int formatRepeat(char* buf, const time_t now) const {
+		formatTimePrefix(buf, now);
+		return 11 + snprintf(buf + 11, 64 - 11, "上条日志重复 %u 次\n", repeatCnt);
+	}
+
+	// 输出积压的重复计数, 须持有 logPrintMutex
+	void flushRepeat(const time_t now) {
+		if (repeatCnt == 0) return;
+
+		char buf[64];
+		const int len = formatRepeat(buf, now);
+		repeatCnt = 0;
+
+		if (toFileFlag)
+			toFile(buf, len);
+		else
+			toMem(buf, len);
+	}
+
+public:
+	// 定期输出积压的重复计数, 文件日志模式下刷新合并缓存 call once per 1sec
+	void checkFlushLog() {
+		lock_guard<mutex> lock(logPrintMutex);
+		const time_t now = time(nullptr);
+		if (repeatCnt && (now - repeatBeginTime) >= REPEAT_FLUSH_INTERVAL)
+			flushRepeat(now);
+		if (toFileFlag && fileCacheLen && (now - lastFlushTime) >= FILE_FLUSH_INTERVAL)
+			flushFile();
+	}
+
+	// 日志文件轮转大小 单位MiB, 0:默认1MiB
+	void setLogFileSize(const int sizeMiB) {
+		lock_guard<mutex> lock(logPrintMutex);
+		logFileMaxSize = sizeMiB > 0 ? sizeMiB * 1024 * 1024 : LOG_FILE_SIZE_DEFAULT;
+	}
+
 	void clearLog() {
-		logCache[0] = '\n';
-		position = 1;
+		lock_guard<mutex> lock(logPrintMutex);
+		lastLineHash = 0;
+		repeatCnt = 0;
+		logHead = logTail;
+		toMem("\n", 1);
+	}
+
+	// 模板日志只记录二进制事件, 文本在读取日志时才渲染
+	void event(const EVENT type, const int uid, const int pidCnt = 0, const int duration = 0,
+		const int value = 0, const int code = 0) {
+		const eventRecord rec{ EVENT_TAG, type, static_cast<uint16_t>(pidCnt),
+			static_cast<uint32_t>(time(nullptr)), uid, duration, value, code };
+
+		lock_guard<mutex> lock(logPrintMutex);
+		flushRepeat(rec.timestamp); // 重复计数先于事件输出, 事件之后的同一行重新计起
+		lastLineHash = 0;
+		if (toFileFlag) {
+			string line;
+			renderEvent(rec, line);
+			toFile(line.c_str(), line.length());
+		}
+		else {
+			toMem(reinterpret_cast<const char*>(&rec), sizeof(rec));
+		}
+	}
+
+	// 事件渲染时通过此回调获取应用名称
+	void setLabelHook(void* ctx, labelHookFunc func) {
+		lock_guard<mutex> lock(logPrintMutex);
+		labelHookCtx = ctx;
+		labelHook = func;
 	}
 
-	char* getLogPtr() {
-		return logCache;
+	// 按 uid(-1:全部) 与类型掩码(bit[type]) 查询事件记录, 返回写入 buf 的字节数
+	size_t queryEvents(const int uid, const uint32_t typeMask, char* buf, const size_t maxLen) {
+		lock_guard<mutex> lock(logPrintMutex);
+
+		size_t len = 0;
+		for (uint64_t seq = logHead; seq < logTail; seq += entryLen(seq)) {
+			if (!isEventAt(seq)) continue;
+			if (len + sizeof(eventRecord) > maxLen) break;
+
+			eventRecord rec;
+			ringRead(seq, &rec, sizeof(rec));
+			if (uid != -1 && rec.uid != uid) continue;
+			if (!(typeMask & (1u << static_cast<uint32_t>(rec.type)))) continue;
+
+			memcpy(buf + len, &rec, sizeof(rec));
+			len += sizeof(rec);
+		}
+		return len;
 	}
 
-	size_t getLoglen() {
-		return position;
+	// 持锁期间回调 func(seg, segCnt, startSeq, endSeq)
+	// 文本行直接引用缓冲区不复制, 事件记录渲染后引用 renderCache, 相邻的同类定时压制合并为一行
+	// sinceSeq: 只取该序号之后的日志, 若已被覆盖或超出范围则从最旧一行开始
+	// 读取不写日志: 积压的重复计数由 checkFlushLog() 定时输出, 完整读取时附加为不入缓冲区的末行
+	// 增量读取(isIncremental)不附加, 否则该行没有序号, 每次轮询都会重复出现
+	template<typename Func>
+	void snapshotLog(Func&& func, const uint64_t sinceSeq = 0, const bool isIncremental = false) {
+		lock_guard<mutex> lock(logPrintMutex);
+
+		const uint64_t startSeq = (logHead <= sinceSeq && sinceSeq <= logTail) ? sinceSeq : logHead;
+
+		renderCache.clear();
+		logPieces.clear();
+
+		uint64_t textBegin = startSeq;
+		uint64_t seq = startSeq;
+		EVENT lastType{};
+		uint32_t lastTimestamp = 0;
+		while (seq < logTail) {
+			if (!isEventAt(seq)) {
+				seq += entryLen(seq);
+				continue;
+			}
+
+			if (seq > textBegin)
+				logPieces.emplace_back(logPiece{ false, textBegin, seq - textBegin });
+
+			eventRecord rec;
+			ringRead(seq, &rec, sizeof(rec));
+			seq += sizeof(eventRecord);
+			textBegin = seq;
+
+			if (isRefreezeEvent(rec.type) && rec.type == lastType && rec.timestamp == lastTimestamp &&
+				!logPieces.empty() && logPieces.back().isRendered &&
+				logPieces.back().begin + logPieces.back().len == renderCache.length()) {
+				char labelTmp[32];
+				const size_t oldLen = renderCache.length();
+				renderCache.back() = ' ';
+				renderCache += getEventLabel(rec.uid, labelTmp, sizeof(labelTmp));
+				renderCache += '\n';
+				logPieces.back().len += renderCache.length() - oldLen;
+				continue;
+			}
+
+			const size_t oldLen = renderCache.length();
+			renderEvent(rec, renderCache);
+			logPieces.emplace_back(logPiece{ true, oldLen, renderCache.length() - oldLen });
+			lastType = rec.type;
+			lastTimestamp = rec.timestamp;
+		}
+		if (logTail > textBegin)
+			logPieces.emplace_back(logPiece{ false, textBegin, logTail - textBegin });
+
+		if (repeatCnt && !isIncremental) {
+			char buf[64];
+			const size_t oldLen = renderCache.length();
+			renderCache.append(buf, formatRepeat(buf, time(nullptr)));
+			logPieces.emplace_back(logPiece{ true, oldLen, renderCache.length() - oldLen });
+		}
+
+		logIov.clear();
+		for (const auto& piece : logPieces) {
+			if (piece.isRendered) {
+				logIov.emplace_back(iovec{ renderCache.data() + piece.begin, piece.len });
+				continue;
+			}
+
+			const size_t idx = piece.begin & BUFF_MASK;
+			const size_t firstLen = std::min(piece.len, BUFF_SIZE - idx);
+			logIov.emplace_back(iovec{ logCache + idx, firstLen });
+			if (piece.len > firstLen)
+				logIov.emplace_back(iovec{ logCache, piece.len - firstLen });
+		}
+
+		func(logIov.data(), static_cast<int>(logIov.size()), startSeq, logTail);
 	}
 };
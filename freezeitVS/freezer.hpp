@@ -6,6 +6,7 @@
 #include "doze.hpp"
 #include "freezeit.hpp"
 #include "systemTools.hpp"
+#include "bufferPool.hpp"
 
 class Freezer {
 private:
@@ -27,11 +28,23 @@ private:
 	uint32_t unfrozenTimeline[4096] = {};
 	map<int, uint32_t> unfrozenIdx;
 
+	// 持有 appListMutex 时只暂停并登记, 释放锁后由 killPendingApps() 统一等待并杀死
+	struct pendingKillStruct {
+		string label;
+		vector<int> pids;
+		bool isCounted = false; // 冻结(杀死后台)的失败计入指标, 定时压制的不计
+	};
+	map<int, pendingKillStruct> pendingKillList;
+	map<int, string> pendingBreakNetworkList; // 定时压制后待断网的QQ/TIM { uid, label }
+
 	int refreezeSecRemain = 70; //开机 一分钟时 就压一次
 	int remainTimesToRefreshTopApp = 2; //允许多线程冲突，不需要原子操作
 
 	static const size_t GET_VISIBLE_BUF_SIZE = 256 * 1024;
-	unique_ptr<char[]> getVisibleAppBuff;
+
+	// 断网仅针对QQ/TIM, 包名入池后按编号比较
+	const istr QQ_PACKAGE = istr::pinned("com.tencent.mobileqq");
+	const istr TIM_PACKAGE = istr::pinned("com.tencent.tim");
 
 	struct binder_state {
 		int fd = -1;
@@ -93,8 +106,6 @@ public:
 		freezeit(freezeit), managedApp(managedApp), systemTools(systemTools),
 		settings(settings), doze(doze) {
 
-		getVisibleAppBuff = make_unique<char[]>(GET_VISIBLE_BUF_SIZE);
-
 		if (freezeit.kernelVersion.main >= 5 && freezeit.kernelVersion.sub >= 10) {
 			const int res = binder_open("/dev/binder");
 			if (res > 0)
@@ -199,10 +210,11 @@ public:
 	}
 
 	void getPids(appInfoStruct& info, const int uid) {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
 		info.pids.clear();
 
+		Metrics::scopedTimer scanTimer(Metrics::procScan.at());
 		DIR* dir = opendir("/proc");
 		if (dir == nullptr) {
 			char errTips[256];
@@ -232,7 +244,7 @@ public:
 			strcat(fullPath + 8, "/cmdline");
 			char readBuff[256];
 			if (Utils::readString(fullPath, readBuff, sizeof(readBuff)) == 0)continue;
-			const string& package = info.package;
+			const istr& package = info.package;
 			if (strncmp(readBuff, package.c_str(), package.length())) continue;
 			const char endChar = readBuff[package.length()];
 			if (endChar != ':' && endChar != 0)continue;
@@ -240,13 +252,14 @@ public:
 			info.pids.emplace_back(pid);
 		}
 		closedir(dir);
-		END_TIME_COUNT;
+		scanTimer.stop();
 	}
 
 	map<int, vector<int>> getRunningPids(set<int>& uidSet) {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 		map<int, vector<int>> pids;
 
+		Metrics::scopedTimer scanTimer(Metrics::procScan.at());
 		DIR* dir = opendir("/proc");
 		if (dir == nullptr) {
 			char errTips[256];
@@ -277,20 +290,21 @@ public:
 			strcat(fullPath + 8, "/cmdline");
 			char readBuff[256];
 			if (Utils::readString(fullPath, readBuff, sizeof(readBuff)) == 0)continue;
-			const string& package = managedApp[uid].package;
+			const istr& package = managedApp[uid].package;
 			if (strncmp(readBuff, package.c_str(), package.length())) continue;
 
 			pids[uid].emplace_back(pid);
 		}
 		closedir(dir);
-		END_TIME_COUNT;
+		scanTimer.stop();
 		return pids;
 	}
 
 	[[maybe_unused]] set<int> getRunningUids(set<int>& uidSet) {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 		set<int> uids;
 
+		Metrics::scopedTimer scanTimer(Metrics::procScan.at());
 		DIR* dir = opendir("/proc");
 		if (dir == nullptr) {
 			char errTips[256];
@@ -321,40 +335,114 @@ public:
 			strcat(fullPath + 8, "/cmdline");
 			char readBuff[256];
 			if (Utils::readString(fullPath, readBuff, sizeof(readBuff)) == 0)continue;
-			const string& package = managedApp[uid].package;
+			const istr& package = managedApp[uid].package;
 			if (strncmp(readBuff, package.c_str(), package.length())) continue;
 
 			uids.insert(uid);
 		}
 		closedir(dir);
-		END_TIME_COUNT;
+		scanTimer.stop();
 		return uids;
 	}
 
-	void handleSignal(const int uid, const vector<int>& pids, const int signal) {
+	// 返回失败的进程数
+	int handleSignal(const int uid, const vector<int>& pids, const int signal) {
 		if (signal == SIGKILL) { //先暂停 然后再杀，否则有可能会复活
 			for (const auto pid : pids)
 				kill(pid, SIGSTOP);
 			usleep(1000 * 100);
 		}
 
-		for (const int pid : pids)
-			if (kill(pid, signal) < 0 && (signal == SIGSTOP || signal == SIGKILL))
+		int failCnt = 0;
+		for (const int pid : pids) {
+			if (kill(pid, signal) < 0 && (signal == SIGSTOP || signal == SIGKILL)) {
+				failCnt++;
 				freezeit.log("%s [%s PID:%d] 失败(SIGSTOP):%s", signal == SIGSTOP ? "冻结" : "杀死",
 					managedApp[uid].label.c_str(), pid, strerror(errno));
+			}
+		}
+		return failCnt;
+	}
+
+	// 批量杀死多个应用: 先全部暂停, 统一等待一次, 再全部杀死, 返回失败的进程数
+	int killApps(const map<int, vector<int>>& uidPids) {
+		for (const auto& [uid, pids] : uidPids)
+			for (const int pid : pids)
+				kill(pid, SIGSTOP);
+		if (uidPids.empty()) return 0;
+		usleep(1000 * 100);
+
+		int failCnt = 0;
+		for (const auto& [uid, pids] : uidPids) {
+			for (const int pid : pids) {
+				if (kill(pid, SIGKILL) < 0) {
+					failCnt++;
+					freezeit.log("杀死 [%s PID:%d] 失败(SIGKILL):%s", managedApp[uid].label.c_str(), pid,
+						strerror(errno));
+				}
+			}
+		}
+		return failCnt;
+	}
+
+	//先暂停 然后再杀，否则有可能会复活; 需持有 lockAppList()
+	void queueKill(const int uid, const vector<int>& pids, const bool isCounted) {
+		auto& pending = pendingKillList[uid];
+		pending.label = managedApp[uid].label.c_str();
+		pending.isCounted |= isCounted;
+		for (const int pid : pids) {
+			if (std::find(pending.pids.begin(), pending.pids.end(), pid) != pending.pids.end()) continue;
+			kill(pid, SIGSTOP);
+			pending.pids.emplace_back(pid);
+		}
+	}
+
+	// 不可持有 lockAppList(): 等待期间工作线程可以访问应用表
+	void killPendingApps() {
+		if (pendingKillList.empty()) return;
+
+		TRACE_SCOPE;
+		usleep(1000 * 100);
+
+		int failCnt = 0;
+		for (const auto& [uid, pending] : pendingKillList) {
+			for (const int pid : pending.pids) {
+				if (kill(pid, SIGKILL) < 0) {
+					if (pending.isCounted) failCnt++;
+					freezeit.log("杀死 [%s PID:%d] 失败(SIGKILL):%s", pending.label.c_str(), pid,
+						strerror(errno));
+				}
+			}
+		}
+		pendingKillList.clear();
+		if (failCnt) Metrics::failTotal.inc(Metrics::BACKEND_TERMINATE, failCnt);
+	}
+
+	// 不可持有 lockAppList()
+	void breakPendingNetwork() {
+		for (const auto& [uid, label] : pendingBreakNetworkList) {
+			usleep(1000 * 100);
+			systemTools.breakNetworkByLocalSocket(uid);
+			freezeit.log("定时压制 断网 [%s]", label.c_str());
+		}
+		pendingBreakNetworkList.clear();
 	}
 
-	void handleFreezer(const int uid, const vector<int>& pids, const int signal) {
+	// 返回失败的进程数
+	int handleFreezer(const int uid, const vector<int>& pids, const int signal) {
 		char path[256];
+		int failCnt = 0;
 
 		switch (workMode) {
 		case WORK_MODE::V2FROZEN: {
 			for (const int pid : pids) {
 				if (!Utils::writeInt(
-					signal == SIGSTOP ? cgroupV2FrozenPath : cgroupV2UnfrozenPath, pid))
+					signal == SIGSTOP ? cgroupV2FrozenPath : cgroupV2UnfrozenPath, pid)) {
+					failCnt++;
 					freezeit.log("%s [%s PID:%d] 失败(V2FROZEN)",
 						(signal == SIGSTOP ? "冻结" : "解冻"),
 						managedApp[uid].label.c_str(), pid);
+				}
 			}
 		}
 								break;
@@ -362,10 +450,12 @@ public:
 		case WORK_MODE::V2UID: {
 			for (const int pid : pids) {
 				snprintf(path, sizeof(path), cgroupV2UidPidPath, uid, pid);
-				if (!Utils::writeString(path, signal == SIGSTOP ? "1" : "0", 2))
-					freezeit.log("%s [%s PID:%d] 失败(进程可能已结束或者Freezer控制器尚未初始化PID路径)",
+				if (!Utils::writeString(path, signal == SIGSTOP ? "1" : "0", 2)) {
+					failCnt++;
+					LOG_LIMIT(10, "%s [%s PID:%d] 失败(进程可能已结束或者Freezer控制器尚未初始化PID路径)",
 						(signal == SIGSTOP ? "冻结" : "解冻"),
 						managedApp[uid].label.c_str(), pid);
+				}
 			}
 			//                snprintf(path, sizeof(path), cgroupV2UidPath, uid);
 			//                if (!Utils::writeString(path, signal == SIGSTOP ? "1" : "0", 2))
@@ -376,24 +466,37 @@ public:
 							 break;
 
 		case WORK_MODE::V1F_ST: {
+			// 每个进程有 freezer 和信号两步, 任一步失败只按一个失败进程计数
 			if (signal == SIGSTOP) {
 				for (const int pid : pids) {
-					if (!Utils::writeInt(cgroupV1FrozenPath, pid))
+					bool isFail = false;
+					if (!Utils::writeInt(cgroupV1FrozenPath, pid)) {
+						isFail = true;
 						freezeit.log("冻结 [%s PID:%d] 失败(V1F_ST_F)",
 							managedApp[uid].label.c_str(), pid);
-					if (kill(pid, signal) < 0)
+					}
+					if (kill(pid, signal) < 0) {
+						isFail = true;
 						freezeit.log("冻结 [%s PID:%d] 失败(V1F_ST_S)",
 							managedApp[uid].label.c_str(), pid);
+					}
+					failCnt += isFail;
 				}
 			}
 			else {
 				for (const int pid : pids) {
-					if (kill(pid, signal) < 0)
+					bool isFail = false;
+					if (kill(pid, signal) < 0) {
+						isFail = true;
 						freezeit.log("解冻 [%s PID:%d] 失败(V1F_ST_S)",
 							managedApp[uid].label.c_str(), pid);
-					if (!Utils::writeInt(cgroupV1UnfrozenPath, pid))
+					}
+					if (!Utils::writeInt(cgroupV1UnfrozenPath, pid)) {
+						isFail = true;
 						freezeit.log("解冻 [%s PID:%d] 失败(V1F_ST_F)",
 							managedApp[uid].label.c_str(), pid);
+					}
+					failCnt += isFail;
 				}
 			}
 		}
@@ -403,9 +506,11 @@ public:
 			for (const int pid : pids) {
 				if (!Utils::writeInt(
 					// 这里填的是你之前定义的freezer V1+的位置
-					signal == SIGSTOP ? cgroupV1UidFrozenPath : cgroupV1UidUnfrozenPath, pid))
+					signal == SIGSTOP ? cgroupV1UidFrozenPath : cgroupV1UidUnfrozenPath, pid)) {
+					failCnt++;
 					freezeit.log("%s [%s] 失败(V1+F) PID:%d", (signal == SIGSTOP ? "冻结" : "解冻"),
 						managedApp[uid].label.c_str(), pid);
+				}
 			}
 		}
 							  break;
@@ -414,9 +519,11 @@ public:
 		case WORK_MODE::V1F: {
 			for (const int pid : pids) {
 				if (!Utils::writeInt(
-					signal == SIGSTOP ? cgroupV1FrozenPath : cgroupV1UnfrozenPath, pid))
+					signal == SIGSTOP ? cgroupV1FrozenPath : cgroupV1UnfrozenPath, pid)) {
+					failCnt++;
 					freezeit.log("%s [%s] 失败(V1F) PID:%d", (signal == SIGSTOP ? "冻结" : "解冻"),
 						managedApp[uid].label.c_str(), pid);
+				}
 			}
 		}
 						   break;
@@ -427,12 +534,13 @@ public:
 		}
 			   break;
 		}
+		return failCnt;
 	}
 
 
 	// 只接受 SIGSTOP SIGCONT
 	int handleProcess(appInfoStruct& info, const int uid, const int signal) {
-		START_TIME_COUNT;
+		TRACE_SCOPE_ARG(__FUNCTION__, uid);
 
 		if (signal == SIGSTOP)
 			getPids(info, uid);
@@ -448,6 +556,7 @@ public:
 			return 0;
 		}
 
+		int backend = static_cast<int>(workMode), failCnt = 0;
 		switch (info.freezeMode) {
 		case FREEZE_MODE::FREEZER: {
 			if (workMode != WORK_MODE::GLOBAL_SIGSTOP) {
@@ -455,9 +564,9 @@ public:
 					const int res = handleBinder(info.pids, signal);
 					if (res < 0 && signal == SIGSTOP && info.isTolerant)
 						return res;
-					handleFreezer(uid, info.pids, signal);
+					failCnt = handleFreezer(uid, info.pids, signal);
 				}
-				else handleFreezer(uid, info.pids, signal);
+				else failCnt = handleFreezer(uid, info.pids, signal);
 				break;
 			}
 			// 如果是全局 WORK_MODE::GLOBAL_SIGSTOP 则顺着执行下面
@@ -467,13 +576,17 @@ public:
 			const int res = handleBinder(info.pids, signal);
 			if (res < 0 && signal == SIGSTOP && info.isTolerant)
 				return res;
-			handleSignal(uid, info.pids, signal);
+			failCnt = handleSignal(uid, info.pids, signal);
+			if (info.freezeMode == FREEZE_MODE::SIGNAL)
+				backend = Metrics::BACKEND_SIGNAL;
 		}
 								break;
 
 		case FREEZE_MODE::TERMINATE: {
-			if (signal == SIGSTOP)
-				handleSignal(uid, info.pids, SIGKILL);
+			if (signal == SIGSTOP) {
+				Metrics::freezeTotal.inc(Metrics::BACKEND_TERMINATE);
+				queueKill(uid, info.pids, true);
+			}
 			return 0;
 		}
 
@@ -484,6 +597,9 @@ public:
 		}
 		}
 
+		(signal == SIGSTOP ? Metrics::freezeTotal : Metrics::thawTotal).inc(backend);
+		if (failCnt) Metrics::failTotal.inc(backend, failCnt);
+
 		if (settings.wakeupTimeoutMin != 120) {
 			// 无论冻结还是解冻都要清除 解冻时间线上已设置的uid
 			auto it = unfrozenIdx.find(uid);
@@ -506,7 +622,7 @@ public:
 		if (settings.enableBreakNetwork && signal == SIGSTOP &&
 			info.freezeMode != FREEZE_MODE::TERMINATE) {
 			auto& package = info.package;
-			if (package == "com.tencent.mobileqq" || package == "com.tencent.tim") {
+			if (package == QQ_PACKAGE || package == TIM_PACKAGE) {
 				const auto ret = systemTools.breakNetworkByLocalSocket(uid);
 				switch (static_cast<REPLY>(ret)) {
 				case REPLY::SUCCESS:
@@ -522,20 +638,20 @@ public:
 			}
 		}
 
-		END_TIME_COUNT;
 		return info.pids.size();
 	}
 
 	// 重新压制第三方。 白名单, 前台, 待冻结列队 都跳过
 	void checkReFreeze() {
-		START_TIME_COUNT;
-
 		if (--refreezeSecRemain > 0) return;
 
+		TRACE_SCOPE;
+
 		refreezeSecRemain = settings.getRefreezeTimeout();
 
 		map<int, vector<int>> terminateList, SIGSTOPList, freezerList;
 
+		Metrics::scopedTimer scanTimer(Metrics::procScan.at());
 		DIR* dir = opendir("/proc");
 		if (dir == nullptr) {
 			char errTips[256];
@@ -565,7 +681,7 @@ public:
 
 			auto& info = managedApp[uid];
 			if (info.freezeMode >= FREEZE_MODE::WHITELIST || pendingHandleList.contains(uid) ||
-				curForegroundApp.contains(uid))
+				curForegroundApp.contains(uid) || pendingKillList.contains(uid))
 				continue;
 
 			strcat(fullPath + 8, "/cmdline");
@@ -589,51 +705,35 @@ public:
 			}
 		}
 		closedir(dir);
+		scanTimer.stop();
 
-		vector<int> uidOfQQTIM;
-		string tmp;
+		// 杀死和断网需要等待, 登记后由循环线程在释放 appListMutex 后执行
 		for (const auto& [uid, pids] : freezerList) {
 			auto& info = managedApp[uid];
-			tmp += ' ';
-			tmp += info.label;
+			freezeit.event(EVENT::REFREEZE_FREEZER, uid, pids.size());
 			handleFreezer(uid, pids, SIGSTOP);
 			managedApp[uid].pids = move(pids);
 
 			if (settings.enableBreakNetwork &&
-				(info.package == "com.tencent.mobileqq" || info.package == "com.tencent.tim"))
-				uidOfQQTIM.emplace_back(uid);
+				(info.package == QQ_PACKAGE || info.package == TIM_PACKAGE))
+				pendingBreakNetworkList[uid] = info.label.c_str();
 		}
-		if (tmp.length()) freezeit.log("定时Freezer压制: %s", tmp.c_str());
 
-		tmp.clear();
 		for (auto& [uid, pids] : SIGSTOPList) {
 			auto& info = managedApp[uid];
-			tmp += ' ';
-			tmp += info.label;
+			freezeit.event(EVENT::REFREEZE_SIGNAL, uid, pids.size());
 			handleSignal(uid, pids, SIGSTOP);
 			managedApp[uid].pids = move(pids);
 
 			if (settings.enableBreakNetwork &&
-				(info.package == "com.tencent.mobileqq" || info.package == "com.tencent.tim"))
-				uidOfQQTIM.emplace_back(uid);
+				(info.package == QQ_PACKAGE || info.package == TIM_PACKAGE))
+				pendingBreakNetworkList[uid] = info.label.c_str();
 		}
-		if (tmp.length()) freezeit.log("定时kill压制: %s", tmp.c_str());
 
-		tmp.clear();
 		for (const auto& [uid, pids] : terminateList) {
-			tmp += ' ';
-			tmp += managedApp[uid].label;
-			handleSignal(uid, pids, SIGKILL);
-		}
-		if (tmp.length()) freezeit.log("定时压制 杀死后台: %s", tmp.c_str());
-
-		for (const int uid : uidOfQQTIM) {
-			usleep(1000 * 100);
-			systemTools.breakNetworkByLocalSocket(uid);
-			freezeit.log("定时压制 断网 [%s]", managedApp[uid].label.c_str());
+			freezeit.event(EVENT::REFREEZE_KILL, uid, pids.size());
+			queueKill(uid, pids, false);
 		}
-
-		END_TIME_COUNT;
 	}
 
 	bool mountFreezerV1() {
@@ -766,8 +866,9 @@ infoEncrypt()
 	}
 
 	void printProcState() {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
+		Metrics::scopedTimer scanTimer(Metrics::procScan.at());
 		DIR* dir = opendir("/proc");
 		if (dir == nullptr) {
 			freezeit.log("错误: %s(), [%d]:[%s]\n", __FUNCTION__, errno, strerror(errno));
@@ -781,9 +882,15 @@ infoEncrypt()
 		set<int> pidSet;
 
 		size_t len = 0;
-		char procStateStr[1024 * 16];
+		constexpr size_t PROC_STATE_SIZE = 1024 * 16;
+		auto procStateBuf = BufferPool::acquire(PROC_STATE_SIZE, BufferPool::OWNER_FREEZER);
+		if (!procStateBuf) {
+			closedir(dir);
+			return;
+		}
+		char* procStateStr = procStateBuf.data();
 
-		STRNCAT(procStateStr, len, "进程冻结状态:\n\n"
+		STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "进程冻结状态:\n\n"
 			" PID | MiB |  状 态  | 进 程\n");
 
 		struct dirent* file;
@@ -827,12 +934,12 @@ infoEncrypt()
 			totalMiB += memMiB;
 
 			if (curForegroundApp.contains(uid)) {
-				STRNCAT(procStateStr, len, "%5d %4d 📱正在前台 %s\n", pid, memMiB, label.c_str());
+				STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "%5d %4d 📱正在前台 %s\n", pid, memMiB, label.c_str());
 				continue;
 			}
 
 			if (pendingHandleList.contains(uid)) {
-				STRNCAT(procStateStr, len, "%5d %4d ⏳等待冻结 %s\n", pid, memMiB, label.c_str());
+				STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "%5d %4d ⏳等待冻结 %s\n", pid, memMiB, label.c_str());
 				continue;
 			}
 
@@ -844,18 +951,18 @@ infoEncrypt()
 				continue;
 			}
 
-			STRNCAT(procStateStr, len, "%5d %4d ", pid, memMiB);
+			STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "%5d %4d ", pid, memMiB);
 			if (!strcmp(readBuff, v2wchan)) {
-				STRNCAT(procStateStr, len, "❄️V2冻结中 %s\n", label.c_str());
+				STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "❄️V2冻结中 %s\n", label.c_str());
 			}
 			else if (!strcmp(readBuff, v1wchan)) {
-				STRNCAT(procStateStr, len, "❄️V1冻结中 %s\n", label.c_str());
+				STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "❄️V1冻结中 %s\n", label.c_str());
 			}
 			else if (!strcmp(readBuff, SIGSTOPwchan)) {
-				STRNCAT(procStateStr, len, "🧊kill冻结中 %s\n", label.c_str());
+				STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "🧊kill冻结中 %s\n", label.c_str());
 			}
 			else if (!strcmp(readBuff, v2xwchan)) {
-				STRNCAT(procStateStr, len, "❄️V2*冻结中 %s\n", label.c_str());
+				STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "❄️V2*冻结中 %s\n", label.c_str());
 				fakerV2Cnt++;
 				// } else if (!strcmp(readBuff, binder_wchan)) {
 				//   res += "运行中(Binder通信) " + label;
@@ -865,11 +972,12 @@ infoEncrypt()
 				//   res += "运行中(就绪态) " + label;
 			}
 			else {
-				STRNCAT(procStateStr, len, "⚠️运行中(%s) %s\n", readBuff, label.c_str());
+				STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "⚠️运行中(%s) %s\n", readBuff, label.c_str());
 				needRefrezze = true;
 			}
 		}
 		closedir(dir);
+		scanTimer.stop();
 
 		if (uidSet.size() == 0) {
 			freezeit.log("设为冻结的应用没有运行");
@@ -877,25 +985,26 @@ infoEncrypt()
 		else {
 
 			if (needRefrezze) {
-				STRNCAT(procStateStr, len, "\n ⚠️ 发现 [未冻结] 的进程, 即将进行冻结 ⚠️\n");
+				STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "\n ⚠️ 发现 [未冻结] 的进程, 即将进行冻结 ⚠️\n");
 				refreezeSecRemain = 0;
 			}
 
-			STRNCAT(procStateStr, len, "\n总计 %d 应用 %d 进程, 占用内存 ", (int)uidSet.size(),
+			STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "\n总计 %d 应用 %d 进程, 占用内存 ", (int)uidSet.size(),
 				(int)pidSet.size());
-			STRNCAT(procStateStr, len, "%.2f GiB", totalMiB / 1024.0);
+			STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, "%.2f GiB", totalMiB / 1024.0);
 			if (fakerV2Cnt)
-				STRNCAT(procStateStr, len, ", 共 %d 进程处于不完整V2冻结状态", fakerV2Cnt);
+				STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, ", 共 %d 进程处于不完整V2冻结状态", fakerV2Cnt);
 			if (isV1Mode())
-				STRNCAT(procStateStr, len, ", V1已冻结状态可能会识别为[运行中]，请到[CPU使用时长]页面查看是否跳动");
+				STRNCAT_N(procStateStr, PROC_STATE_SIZE, len, ", V1已冻结状态可能会识别为[运行中]，请到[CPU使用时长]页面查看是否跳动");
 
 			freezeit.log(procStateStr);
 		}
-		END_TIME_COUNT;
 	}
 
 	// 解冻新APP, 旧APP加入待冻结列队 call once per 0.5 sec when Touching
 	void updateAppProcess() {
+		TRACE_SCOPE;
+
 		vector<int> newShowOnApp, switch2BackApp;
 
 		for (const int uid : curForegroundApp)
@@ -921,8 +1030,8 @@ infoEncrypt()
 			info.startRunningTime = time(nullptr);
 
 			const int num = handleProcess(info, uid, SIGCONT);
-			if (num > 0) freezeit.log("☀️解冻 %s %d进程", info.label.c_str(), num);
-			else freezeit.log("😁打开 %s", info.label.c_str());
+			if (num > 0) freezeit.event(EVENT::THAW, uid, num);
+			else freezeit.event(EVENT::OPEN, uid);
 		}
 
 		for (const int uid : switch2BackApp) // 更新倒计时
@@ -932,6 +1041,10 @@ infoEncrypt()
 
 	// 处理待冻结列队 call once per 1sec
 	void processPendingApp() {
+		if (pendingHandleList.empty()) return;
+
+		TRACE_SCOPE;
+
 		auto it = pendingHandleList.begin();
 		for (; it != pendingHandleList.end();) {
 			auto& remainSec = it->second;
@@ -945,44 +1058,23 @@ infoEncrypt()
 			const int num = handleProcess(info, uid, SIGSTOP);
 			if (num < 0) {
 				remainSec = static_cast<int>(settings.freezeTimeout) << (++info.failFreezeCnt);
-				if (remainSec < 60)
-					freezeit.log("%s:%d Binder正在传输, 延迟冻结 %d秒", info.label.c_str(), -num, remainSec);
-				else
-					freezeit.log("%s:%d Binder正在传输, 延迟冻结 %d分%d秒", info.label.c_str(), -num,
-						remainSec / 60, remainSec % 60);
+				freezeit.event(EVENT::BINDER_DELAY, uid, 0, remainSec, -num);
+				Metrics::binderDeferTotal.inc();
 				it++;
 				continue;
 			}
 			it = pendingHandleList.erase(it);
 			info.failFreezeCnt = 0;
 
-			char timeStr[128]{};
-			size_t len = 0;
-
 			const int delta = info.startRunningTime != 0 ?
 				(time(nullptr) - info.startRunningTime) : 0;
 			info.totalRunningTime += delta;
 			const int total = info.totalRunningTime;
 
-			STRNCAT(timeStr, len, "运行");
-			if (delta >= 3600)
-				STRNCAT(timeStr, len, "%d时", delta / 3600);
-			if (delta >= 60)
-				STRNCAT(timeStr, len, "%d分", (delta % 3600) / 60);
-			STRNCAT(timeStr, len, "%d秒", delta % 60);
-
-			STRNCAT(timeStr, len, " 累计");
-			if (total >= 3600)
-				STRNCAT(timeStr, len, "%d时", total / 3600);
-			if (total >= 60)
-				STRNCAT(timeStr, len, "%d分", (total % 3600) / 60);
-			STRNCAT(timeStr, len, "%d秒", total % 60);
-
 			if (num)
-				freezeit.log("%s冻结 %s %d进程 %s",
-					info.freezeMode == FREEZE_MODE::SIGNAL ? "🧊" : "❄️",
-					info.label.c_str(), num, timeStr);
-			else freezeit.log("😭关闭 %s %s", info.label.c_str(), timeStr);
+				freezeit.event(EVENT::FREEZE, uid, num, delta, total,
+					static_cast<int>(info.freezeMode));
+			else freezeit.event(EVENT::CLOSE, uid, 0, delta, total);
 		}
 	}
 
@@ -1001,10 +1093,10 @@ infoEncrypt()
 			if (num > 0) {
 				info.startRunningTime = time(nullptr);
 				pendingHandleList[uid] = settings.freezeTimeout;//更新待冻结倒计时
-				freezeit.log("☀️定时解冻 %s %d进程", info.label.c_str(), num);
+				freezeit.event(EVENT::TIMED_THAW, uid, num);
 			}
 			else {
-				freezeit.log("🗑️后台被杀 %s", info.label.c_str());
+				freezeit.event(EVENT::KILLED_BACK, uid);
 			}
 		}
 		else {
@@ -1015,14 +1107,16 @@ infoEncrypt()
 
 	// 常规查询前台 只返回第三方, 剔除白名单/桌面
 	void getVisibleAppByShell() {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
 		curForegroundApp.clear();
 		const char* cmdList[] = { "/system/bin/cmd", "cmd", "activity", "stack", "list", nullptr };
-		VPOPEN::vpopen(cmdList[0], cmdList + 1, getVisibleAppBuff.get(), GET_VISIBLE_BUF_SIZE);
+		auto visibleBuf = BufferPool::acquire(GET_VISIBLE_BUF_SIZE, BufferPool::OWNER_FREEZER);
+		if (!visibleBuf) return;
+		VPOPEN::vpopen(cmdList[0], cmdList + 1, visibleBuf.data(), GET_VISIBLE_BUF_SIZE);
 
 		stringstream ss;
-		ss << getVisibleAppBuff.get();
+		ss << visibleBuf.data();
 
 		// 以下耗时仅为 VPOPEN::vpopen 的 2% ~ 6%
 		string line;
@@ -1055,20 +1149,20 @@ infoEncrypt()
 
 		if (curForegroundApp.size() >= (lastForegroundApp.size() + 3)) //有时系统会虚报大量前台应用
 			curForegroundApp = lastForegroundApp;
-
-		END_TIME_COUNT;
 	}
 
 	// 常规查询前台 只返回第三方, 剔除白名单/桌面
 	void getVisibleAppByShellLRU(set<int>& cur) {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
 		cur.clear();
 		const char* cmdList[] = { "/system/bin/dumpsys", "dumpsys", "activity", "lru", nullptr };
-		VPOPEN::vpopen(cmdList[0], cmdList + 1, getVisibleAppBuff.get(), GET_VISIBLE_BUF_SIZE);
+		auto visibleBuf = BufferPool::acquire(GET_VISIBLE_BUF_SIZE, BufferPool::OWNER_FREEZER);
+		if (!visibleBuf) return;
+		VPOPEN::vpopen(cmdList[0], cmdList + 1, visibleBuf.data(), GET_VISIBLE_BUF_SIZE);
 
 		stringstream ss;
-		ss << getVisibleAppBuff.get();
+		ss << visibleBuf.data();
 
 		// 以下耗时仅 0.08-0.14ms, VPOPEN::vpopen 15-60ms
 		string line;
@@ -1181,11 +1275,12 @@ infoEncrypt()
 				}
 			}
 		}
-		END_TIME_COUNT;
 	}
 
+	// 请求在锁外进行, 更新前台列表时才持有 lockAppList(), 调用方不可持锁
 	void getVisibleAppByLocalSocket() {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
+		Metrics::scopedTimer queryTimer(Metrics::foregroundQuery.at());
 
 		int buff[64];
 		int recvLen = Utils::localSocketRequest(XPOSED_CMD::GET_FOREGROUND, nullptr, 0, buff,
@@ -1193,25 +1288,26 @@ infoEncrypt()
 
 		int& UidLen = buff[0];
 		if (recvLen <= 0) {
-			freezeit.log("%s() 工作异常, 请确认LSPosed中冻它勾选系统框架, 然后重启", __FUNCTION__);
-			END_TIME_COUNT;
+			Metrics::foregroundQueryFail.inc();
+			LOG_LIMIT(60, "%s() 工作异常, 请确认LSPosed中冻它勾选系统框架, 然后重启", __FUNCTION__);
 			return;
 		}
 		else if (UidLen > 16 || (UidLen != (recvLen / 4 - 1))) {
+			Metrics::foregroundQueryFail.inc();
 			freezeit.log("%s() 前台服务数据异常 UidLen[%d] recvLen[%d]", __FUNCTION__, UidLen, recvLen);
 			if (recvLen < 64 * 4)
 				freezeit.log("DumpHex: %s", Utils::bin2Hex(buff, recvLen).c_str());
 			else
 				freezeit.log("DumpHex: %s ...", Utils::bin2Hex(buff, 64 * 4).c_str());
-			END_TIME_COUNT;
 			return;
 		}
 
+		const auto appListLock = managedApp.lockAppList();
 		curForegroundApp.clear();
 		for (int i = 1; i <= UidLen; i++) {
 			int& uid = buff[i];
 			if (managedApp.contains(uid)) curForegroundApp.insert(uid);
-			else freezeit.log("非法UID[%d], 可能是新安装的应用, 请点击右上角第一个按钮更新应用列表", uid);
+			else LOG_LIMIT(60, "非法UID[%d], 可能是新安装的应用, 请点击右上角第一个按钮更新应用列表", uid);
 		}
 
 #if DEBUG_DURATION
@@ -1223,7 +1319,6 @@ infoEncrypt()
 		else
 			freezeit.log("LOCALSOCKET前台 空");
 #endif
-		END_TIME_COUNT;
 	}
 
 
@@ -1282,6 +1377,8 @@ infoEncrypt()
 	void cpuSetTriggerTask() {
 		constexpr int TRIGGER_BUF_SIZE = 8192;
 
+		Trace::setThreadName("cpuset");
+
 		sleep(1);
 
 		int inotifyFd = inotify_init();
@@ -1305,6 +1402,7 @@ infoEncrypt()
 		constexpr int REMAIN_TIMES_MAX = 2;
 		char buf[TRIGGER_BUF_SIZE];
 		while (read(inotifyFd, buf, TRIGGER_BUF_SIZE) > 0) {
+			Trace::instant("cpusetEvent");
 			remainTimesToRefreshTopApp = REMAIN_TIMES_MAX;
 			usleep(500 * 1000);
 		}
@@ -1318,17 +1416,25 @@ infoEncrypt()
 	[[noreturn]] void cycleThreadFunc() {
 		uint32_t halfSecondCnt{ 0 };
 
+		Trace::setThreadName("cycle");
+
 		sleep(1);
-		getVisibleAppByShell(); // 获取桌面
+		{
+			const auto appListLock = managedApp.lockAppList();
+			getVisibleAppByShell(); // 获取桌面
+		}
 
+		// 应用表及前台/待冻结列表只在持有 appListMutex 时读写(工作线程同样持锁)
+		// dumpsys/system()、杀死前的等待等耗时操作都在锁外执行, 不阻塞工作线程
 		while (true) {
 			usleep(500 * 1000);
 
 			if (remainTimesToRefreshTopApp > 0) {
 				remainTimesToRefreshTopApp--;
-				START_TIME_COUNT;
+				TRACE_SCOPE_NAMED("refreshTopApp");
 				if (doze.isScreenOffStandby) {
 					if (doze.checkIfNeedToExit()) {
+						const auto appListLock = managedApp.lockAppList();
 						curForegroundApp = move(curFgBackup); // recovery
 						updateAppProcess();
 						setWakeupLockByLocalSocket(WAKEUP_LOCK::DEFAULT);
@@ -1336,23 +1442,35 @@ infoEncrypt()
 				}
 				else {
 #ifdef __x86_64__
+					const auto appListLock = managedApp.lockAppList();
 					getVisibleAppByShellLRU(curForegroundApp);
 #else
 					getVisibleAppByLocalSocket();
+					const auto appListLock = managedApp.lockAppList();
 #endif
 					updateAppProcess(); // ~40us
 				}
-				END_TIME_COUNT;
 			}
 
 			if (++halfSecondCnt & 1) continue;
 
 			systemTools.cycleCnt++;
 
-			processPendingApp();//1秒一次
+			{
+				const auto appListLock = managedApp.lockAppList();
+				managedApp.applyAppListChange();
+				processPendingApp();//1秒一次
+				Metrics::pendingApps.set(pendingHandleList.size());
+			}
+			killPendingApps();
+			freezeit.checkFlushLog();
+			systemTools.sampleSelfCost();
+			BufferPool::trim();
+			StrArena::trim();
 
 			// 2分钟一次 在亮屏状态检测是否已经息屏  息屏状态则检测是否再次强制进入深度Doze
 			if (doze.checkIfNeedToEnter()) {
+				const auto appListLock = managedApp.lockAppList();
 				curFgBackup = move(curForegroundApp); //backup
 				updateAppProcess();
 				setWakeupLockByLocalSocket(WAKEUP_LOCK::IGNORE);
@@ -1361,8 +1479,13 @@ infoEncrypt()
 			if (doze.isScreenOffStandby)continue;// 息屏状态 不用执行 以下功能
 
 			systemTools.checkBattery();// 1分钟一次 电池检测
-			checkReFreeze();// 重新压制切后台的应用
-			checkWakeup();// 检查是否有定时解冻
+			{
+				const auto appListLock = managedApp.lockAppList();
+				checkReFreeze();// 重新压制切后台的应用
+				checkWakeup();// 检查是否有定时解冻
+			}
+			killPendingApps();
+			breakPendingNetwork();
 		}
 	}
 
@@ -1370,8 +1493,9 @@ infoEncrypt()
 	void getBlackListUidRunning(set<int>& uids) {
 		uids.clear();
 
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
+		Metrics::scopedTimer scanTimer(Metrics::procScan.at());
 		DIR* dir = opendir("/proc");
 		if (dir == nullptr) {
 			char errTips[256];
@@ -1409,12 +1533,12 @@ infoEncrypt()
 			uids.insert(uid);
 		}
 		closedir(dir);
-		END_TIME_COUNT;
+		scanTimer.stop();
 	}
 
 	int setWakeupLockByLocalSocket(const WAKEUP_LOCK& mode) {
 		static set<int> blackListUidRunning;
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
 		if (mode == WAKEUP_LOCK::IGNORE)
 			getBlackListUidRunning(blackListUidRunning);
@@ -1430,18 +1554,15 @@ infoEncrypt()
 			i * sizeof(int), buff, sizeof(buff));
 
 		if (recvLen == 0) {
-			freezeit.log("%s() 工作异常, 请确认LSPosed中冻它勾选系统框架, 然后重启", __FUNCTION__);
-			END_TIME_COUNT;
+			LOG_LIMIT(60, "%s() 工作异常, 请确认LSPosed中冻它勾选系统框架, 然后重启", __FUNCTION__);
 			return 0;
 		}
 		else if (recvLen != 4) {
 			freezeit.log("%s() 返回数据异常 recvLen[%d]", __FUNCTION__, recvLen);
 			if (recvLen > 0 && recvLen < 64 * 4)
 				freezeit.log("DumpHex: %s", Utils::bin2Hex(buff, recvLen).c_str());
-			END_TIME_COUNT;
 			return 0;
 		}
-		END_TIME_COUNT;
 		return buff[0];
 	}
 
@@ -1486,7 +1607,7 @@ infoEncrypt()
 	int handleBinder(const vector<int>& pids, const int signal) {
 		if (bs.fd <= 0)return 1;
 
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 		struct binder_freeze_info info { 0, static_cast<uint32_t>(signal == SIGSTOP ? 1 : 0), 100 };
 		for (const int pid : pids) {
 			info.pid = pid;
@@ -1494,7 +1615,6 @@ infoEncrypt()
 				return -pid;
 			}
 		}
-		END_TIME_COUNT;
 		return 1;
 	}
 };
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "utils.hpp"
+
+// 文本文件按行解析: 只读映射整个文件, 行与字段均以 string_view 指向映射区, 不复制、不分配
+// 映射期间文件被截断会触发 SIGBUS, 仅用于 原子替换的(packages.list) 或 仅本进程写入的文件
+namespace LineScan {
+
+	class mappedFile {
+	private:
+		const char* ptr = nullptr;
+		size_t len = 0;
+
+	public:
+		explicit mappedFile(const char* path) {
+			const int fd = open(path, O_RDONLY | O_CLOEXEC);
+			if (fd < 0) return;
+
+			struct stat st {};
+			if (fstat(fd, &st) == 0 && st.st_size > 0) {
+				void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (addr != MAP_FAILED) {
+					madvise(addr, st.st_size, MADV_SEQUENTIAL);
+					ptr = static_cast<const char*>(addr);
+					len = st.st_size;
+				}
+			}
+			close(fd);
+		}
+
+		mappedFile(const mappedFile&) = delete;
+		mappedFile& operator=(const mappedFile&) = delete;
+
+		~mappedFile() {
+			if (ptr) munmap(const_cast<char*>(ptr), len);
+		}
+
+		// 文件不存在、为空或映射失败
+		explicit operator bool() const { return ptr != nullptr; }
+
+		string_view view() const { return { ptr, len }; }
+
+		// 逐行回调 func(string_view line), 不含行尾 \n 或 \r\n, 末行可无换行符
+		template<typename F>
+		void forEachLine(F&& func) const {
+			const char* cur = ptr;
+			const char* end = ptr + len;
+			while (cur < end) {
+				const char* lineEnd = static_cast<const char*>(memchr(cur, '\n', end - cur));
+				if (!lineEnd) lineEnd = end;
+
+				size_t lineLen = lineEnd - cur;
+				if (lineLen && cur[lineLen - 1] == '\r') lineLen--;
+				func(string_view(cur, lineLen));
+				cur = lineEnd + 1;
+			}
+		}
+	};
+
+	// 取出下一个字段并从 line 中移除, 连续的分隔符视为一个(同 Utils::splitString), 无字段时返回空
+	inline string_view nextField(string_view& line, const char delim) {
+		size_t begin = 0;
+		while (begin < line.length() && line[begin] == delim) begin++;
+
+		size_t end = line.find(delim, begin);
+		if (end == string_view::npos) end = line.length();
+
+		const string_view field = line.substr(begin, end - begin);
+		line.remove_prefix(end);
+		return field;
+	}
+
+	// 整个字段须为十进制整数(可带负号), 不接受空字段、溢出及其他字符
+	inline bool parseInt(string_view str, int& value) {
+		const bool isNegative = !str.empty() && str[0] == '-';
+		if (isNegative) str.remove_prefix(1);
+		if (str.empty() || str.length() > 10) return false;
+
+		int64_t res = 0;
+		for (const char c : str) {
+			if (c < '0' || '9' < c) return false;
+			res = res * 10 + (c - '0');
+		}
+		if (isNegative) res = -res;
+		if (res < INT_MIN || INT_MAX < res) return false;
+		value = static_cast<int>(res);
+		return true;
+	}
+}
@@ -69,8 +69,10 @@ fi
 ORG_appcfg="/data/adb/modules/freezeit/appcfg.txt"
 ORG_applabel="/data/adb/modules/freezeit/applabel.txt"
 ORG_settings="/data/adb/modules/freezeit/settings.db"
+ORG_config_snap="/data/adb/modules/freezeit/config.snap"
+ORG_config_journal="/data/adb/modules/freezeit/config.journal"
 
-for path in $ORG_appcfg $ORG_applabel $ORG_settings; do
+for path in $ORG_appcfg $ORG_applabel $ORG_settings $ORG_config_snap $ORG_config_journal; do
     if [ -e $path ]; then
         cp -f $path "$MODPATH"
     fi
@@ -13,6 +13,7 @@
  */
 
 #include "freezeit.hpp"
+#include "configStore.hpp"
 #include "settings.hpp"
 #include "managedApp.hpp"
 #include "systemTools.hpp"
@@ -25,8 +26,9 @@ int main(int argc, char **argv) {
     Utils::Init();
 
     Freezeit freezeit(argc, argv[0]);
-    Settings settings(freezeit);
-    ManagedApp managedApp(freezeit, settings);
+    ConfigStore configStore(freezeit);
+    Settings settings(freezeit, configStore);
+    ManagedApp managedApp(freezeit, settings, configStore);
     SystemTools systemTools(freezeit, settings);
     Doze doze(freezeit, settings, managedApp, systemTools);
     Freezer freezer(freezeit, settings, managedApp, systemTools, doze);
@@ -3,369 +3,38 @@
 #include "utils.hpp"
 #include "freezeit.hpp"
 #include "settings.hpp"
+#include "configStore.hpp"
 #include "vpopen.hpp"
+#include "bufferPool.hpp"
+#include "uidTable.hpp"
+#include "whitelist.hpp"
+#include "lineScan.hpp"
 
 
 class ManagedApp {
 private:
-	string cfgPath;
-	string labelPath;
+	string cfgPath;   // 旧版配置文件, 仅用于迁移到配置库
+	string labelPath; // 同上
 
 	Freezeit& freezeit;
 	Settings& settings;
+	ConfigStore& configStore;
 
 	static const size_t PACKAGE_LIST_BUF_SIZE = 256 * 1024;
-	unique_ptr<char[]> packageListBuff;
 
 	string homePackage;
-	map<int, appInfoStruct> infoMap;
-	map<string, int> uidIndex;
+	UidTable<appInfoStruct> infoMap;
+	std::unordered_map<istr, int> uidIndex; // 包名按编号哈希
 	map<int, cfgStruct> cfgTemp;
 
-	const unordered_set<string> whiteListForce{
-			"com.xiaomi.mibrain.speech",            // 系统语音引擎
-			"com.xiaomi.scanner",                   // 小爱视觉
-			"com.xiaomi.xmsf",                      // Push
-			"com.xiaomi.xmsfkeeper",                // Push
-			"com.xiaomi.misettings",                // 设置
-			"com.xiaomi.barrage",                   // 弹幕通知
-			"com xiaomi.aireco",                    // 小爱建议
-			"com.xiaomi.account",                   // 小米账号
-			"com.mfashiongallery.emag",             // 小米画报
-			"com.huawei.hwid",                      // HMS core服务
-
-			"cn.litiaotiao.app",                    // 李跳跳
-			"com.litiaotiao.app",                   // 李跳跳
-			"hello.litiaotiao.app",                 // 李跳跳
-			"com.topjohnwu.magisk",                 // Magisk
-			"io.github.vvb2060.magisk",             // Magisk Alpha
-			"io.github.huskydg.magisk",             // Magisk Delta
-			"io.github.jark006.freezeit",           // 冻它
-			"io.github.jark006.weather",            // 小天气
-			"com.jark006.weather",                  // 小天气
-			"org.lsposed.manager",                  // LSPosed
-			"com.github.tianma8023.xposed.smscode", // XposedSmsCode
-			"com.merxury.blocker",                  // Blocker
-			"com.wpengapp.lightstart",              // 轻启动
-			"name.monwf.customiuizer",              // 米客 原版
-			"name.mikanoshi.customiuizer",          // 米客
-
-			"org.meowcat.xposed.mipush",            // 小米推送框架增强
-			"top.trumeet.mipush",                   // 小米推送服务
-			"one.yufz.hmspush",                     // HMSPush服务
-
-			"app.lawnchair",                        // Lawnchair
-			"com.microsoft.launcher",               // 微软桌面
-			"com.teslacoilsw.launcher",             // Nova Launcher
-			"com.hola.launcher",                    // Hola桌面
-			"com.transsion.XOSLauncher",            // XOS桌面
-			"com.mi.android.globallauncher",        // POCO桌面
-			"com.gau.go.launcherex",                // GO桌面
-			"bitpit.launcher",                      // Niagara Launcher
-			"com.google.android.apps.nexuslauncher",// pixel 桌面
-			"com.oppo.launcher",
-
-			"me.weishu.kernelsu",                   // KernelSU
-			"top.canyie.dreamland.manager",         // Dreamland
-
-			"com.miui.home",
-			"com.miui.carlink",
-			"com.miui.packageinstaller",            // 安装包管理
-			"com.coloros.packageinstaller",         // 安装包管理
-			"com.oplus.packageinstaller",           // 安装包管理
-			"com.iqoo.packageinstaller",            // 安装包管理
-			"com.vivo.packageinstaller",            // 安装包管理
-			"com.google.android.packageinstaller",  // 软件包安装程序
-
-
-			"com.baidu.input",                            //百度输入法
-			"com.baidu.input_huawei",                     //百度输入法华为版
-			"com.baidu.input_mi",                         //百度输入法小米版
-			"com.baidu.input_oppo",                       //百度输入法OPPO版
-			"com.baidu.input_vivo",                       //百度输入法VIVO版
-			"com.baidu.input_yijia",                      //百度输入法一加版
-
-			"com.sohu.inputmethod.sogou",                 //搜狗输入法
-			"com.sohu.inputmethod.sogou.xiaomi",          //搜狗输入法小米版
-			"com.sohu.inputmethod.sogou.meizu",           //搜狗输入法魅族版
-			"com.sohu.inputmethod.sogou.nubia",           //搜狗输入法nubia版
-			"com.sohu.inputmethod.sogou.chuizi",          //搜狗输入法chuizi版
-			"com.sohu.inputmethod.sogou.moto",            //搜狗输入法moto版
-			"com.sohu.inputmethod.sogou.zte",             //搜狗输入法中兴版
-			"com.sohu.inputmethod.sogou.samsung",         //搜狗输入法samsung版
-			"com.sohu.input_yijia",                       //搜狗输入法一加版
-
-			"com.iflytek.inputmethod",                    //讯飞输入法
-			"com.iflytek.inputmethod.miui",               //讯飞输入法小米版
-			"com.iflytek.inputmethod.googleplay",         //讯飞输入法googleplay版
-			"com.iflytek.inputmethod.smartisan",          //讯飞输入法smartisan版
-			"com.iflytek.inputmethod.oppo",               //讯飞输入法oppo版
-			"com.iflytek.inputmethod.oem",                //讯飞输入法oem版
-			"com.iflytek.inputmethod.custom",             //讯飞输入法custom版
-			"com.iflytek.inputmethod.blackshark",         //讯飞输入法blackshark版
-			"com.iflytek.inputmethod.zte",                //讯飞输入法zte版
-
-			"com.tencent.qqpinyin",                       // QQ拼音输入法
-			"com.google.android.inputmethod.latin",       //谷歌Gboard输入法
-			"com.touchtype.swiftkey",                     //微软swiftkey输入法
-			"com.touchtype.swiftkey.beta",                //微软swiftkeyBeta输入法
-			"im.weshine.keyboard",                        // KK键盘输入法
-			"com.komoxo.octopusime",                      //章鱼输入法
-			"com.qujianpan.duoduo",                       //见萌输入法
-			"com.lxlm.lhl.softkeyboard",                  //流行输入法
-			"com.jinkey.unfoldedime",                     //不折叠输入法
-			"com.iflytek.inputmethods.DungkarIME",        //东噶藏文输入法
-			"com.oyun.qingcheng",                         //奥云蒙古文输入法
-			"com.ziipin.softkeyboard",                    // Badam维语输入法
-			"com.kongzue.secretinput",                    // 密码键盘
-
-
-			"com.google.android.ext.services",
-			"com.google.android.ext.shared",
-
-			"com.android.launcher",
-			"com.android.launcher2",
-			"com.android.launcher3",
-			"com.android.launcher4",
-			"com.android.apps.tag", // Tags
-			"com.android.bips", // 系统打印服务
-			"com.android.bluetoothmidiservice", // Bluetooth MIDI Service
-			"com.android.cameraextensions", // CameraExtensionsProxy
-			"com.android.captiveportallogin", // CaptivePortalLogin
-			"com.android.carrierdefaultapp", // 运营商默认应用
-			"com.android.certinstaller", // 证书安装程序
-			"com.android.companiondevicemanager", // 配套设备管理器
-			"com.android.connectivity.resources", // 系统网络连接资源
-			"com.android.contacts", // 通讯录与拨号
-			"com.android.deskclock", // 时钟
-			"com.android.dreams.basic", // 基本互动屏保
-			"com.android.egg", // Android S Easter Egg
-			"com.android.emergency", // 急救信息
-			"com.android.externalstorage", // 外部存储设备
-			"com.android.hotspot2.osulogin", // OsuLogin
-			"com.android.htmlviewer", // HTML 查看器
-			"com.android.incallui", // 电话
-			"com.android.internal.display.cutout.emulation.corner", // 边角刘海屏
-			"com.android.internal.display.cutout.emulation.double", // 双刘海屏
-			"com.android.internal.display.cutout.emulation.hole", // 打孔屏
-			"com.android.internal.display.cutout.emulation.tall", // 长型刘海屏
-			"com.android.internal.display.cutout.emulation.waterfall", // 瀑布刘海屏
-			"com.android.internal.systemui.navbar.gestural", // Gestural Navigation Bar
-			"com.android.internal.systemui.navbar.gestural_extra_wide_back", // Gestural Navigation Bar
-			"com.android.internal.systemui.navbar.gestural_narrow_back", // Gestural Navigation Bar
-			"com.android.internal.systemui.navbar.gestural_wide_back", // Gestural Navigation Bar
-			"com.android.internal.systemui.navbar.threebutton", // 3 Button Navigation Bar
-			"com.android.managedprovisioning", // 工作设置
-			"com.android.mms", // 短信
-			"com.android.modulemetadata", // Module Metadata
-			"com.android.mtp", // MTP 主机
-			"com.android.musicfx", // MusicFX
-			"com.android.networkstack.inprocess.overlay", // NetworkStackInProcessResOverlay
-			"com.android.networkstack.overlay", // NetworkStackOverlay
-			"com.android.networkstack.tethering.inprocess.overlay", // TetheringResOverlay
-			"com.android.networkstack.tethering.overlay", // TetheringResOverlay
-			"com.android.packageinstaller", // 软件包安装程序
-			"com.android.pacprocessor", // PacProcessor
-			"com.android.permissioncontroller", // 权限控制器
-			"com.android.printspooler", // 打印处理服务
-			"com.android.providers.calendar", // 日历存储
-			"com.android.providers.contacts", // 联系人存储
-			"com.android.providers.downloads.ui", // 下载管理
-			"com.android.providers.media.module", // 媒体存储设备
-			"com.android.proxyhandler", // ProxyHandler
-			"com.android.server.telecom.overlay.miui", // 通话管理
-			"com.android.settings.intelligence", // 设置建议
-			"com.android.simappdialog", // Sim App Dialog
-			"com.android.soundrecorder", // 录音机
-			"com.android.statementservice", // 意图过滤器验证服务
-			"com.android.storagemanager", // 存储空间管理器
-			"com.android.theme.font.notoserifsource", // Noto Serif / Source Sans Pro
-			"com.android.traceur", // 系统跟踪
-			"com.android.uwb.resources", // System UWB Resources
-			"com.android.vpndialogs", // VpnDialogs
-			"com.android.wallpaper.livepicker", // Live Wallpaper Picker
-			"com.android.wifi.resources", // 系统 WLAN 资源
-			"com.debug.loggerui", // DebugLoggerUI
-			"com.fingerprints.sensortesttool", // Sensor Test Tool
-			"com.lbe.security.miui", // 权限管理服务
-			"com.mediatek.callrecorder", // 通话录音机
-			"com.mediatek.duraspeed", // 快霸
-			"com.mediatek.engineermode", // EngineerMode
-			"com.mediatek.lbs.em2.ui", // LocationEM2
-			"com.mediatek.location.mtkgeofence", // Mtk Geofence
-			"com.mediatek.mdmconfig", // MDMConfig
-			"com.mediatek.mdmlsample", // MDMLSample
-			"com.mediatek.miravision.ui", // MiraVision
-			"com.mediatek.op01.telecom", // OP01Telecom
-			"com.mediatek.op09clib.phone.plugin", // OP09ClibTeleService
-			"com.mediatek.op09clib.telecom", // OP09ClibTelecom
-			"com.mediatek.ygps", // YGPS
-			"com.miui.accessibility", // 小米无障碍
-			"com.miui.core", // MIUI SDK
-			"com.miui.privacycomputing", // MIUI Privacy Components
-			"com.miui.securityadd", // 系统服务组件
-			"com.miui.securityinputmethod", // 小米安全键盘
-			"com.miui.system", // com.miui.internal.app.SystemApplication
-			"com.miui.vpnsdkmanager", // MiuiVpnSdkManager
-			"com.tencent.soter.soterserver", // SoterService
-			"com.unionpay.tsmservice.mi", // 银联可信服务安全组件小米版本
-
-
-			"android.ext.services", // Android Services Library
-			"android.ext.shared", // Android Shared Library
-			"com.android.adservices.api", // Android AdServices
-			"com.android.bookmarkprovider", // Bookmark Provider
-			"com.android.cellbroadcastreceiver.module", // 无线紧急警报
-			"com.android.dialer", // 电话
-			"com.android.dreams.phototable", // 照片屏幕保护程序
-			"com.android.inputmethod.latin", // Android 键盘 (AOSP)
-			"com.android.intentresolver", // IntentResolver
-			"com.android.internal.display.cutout.emulation.noCutout", // 隐藏
-			"com.android.internal.systemui.navbar.twobutton", // 2 Button Navigation Bar
-			"com.android.messaging", // 短信
-			"com.android.onetimeinitializer", // One Time Init
-			"com.android.printservice.recommendation", // Print Service Recommendation Service
-			"com.android.safetycenter.resources", // 安全中心资源
-			"com.android.soundpicker", // 声音
-			"com.android.systemui", // 系统界面
-			"com.android.wallpaper", // 壁纸和样式
-			"com.qualcomm.qti.cne", // CneApp
-			"com.qualcomm.qti.poweroffalarm", // 关机闹钟
-			"com.qualcomm.wfd.service", // Wfd Service
-			"org.lineageos.aperture", // 相机
-			"org.lineageos.audiofx", // AudioFX
-			"org.lineageos.backgrounds", // 壁纸
-			"org.lineageos.customization", // Lineage Themes
-			"org.lineageos.eleven", // 音乐
-			"org.lineageos.etar", // 日历
-			"org.lineageos.jelly", // 浏览器
-			"org.lineageos.overlay.customization.blacktheme", // Black theme
-			"org.lineageos.overlay.font.lato", // Lato
-			"org.lineageos.overlay.font.rubik", // Rubik
-			"org.lineageos.profiles", // 情景模式信任提供器
-			"org.lineageos.recorder", // 录音机
-			"org.lineageos.updater", // 系统更新
-			"org.protonaosp.deviceconfig", // Simple Device Configuration
-
-			"android.aosp.overlay",
-			"android.miui.home.launcher.res",
-			"android.miui.overlay",
-			"com.android.carrierconfig",
-			"com.android.carrierconfig.overlay.miui",
-			"com.android.incallui.overlay",
-			"com.android.managedprovisioning.overlay",
-			"com.android.ondevicepersonalization.services",
-			"com.android.overlay.cngmstelecomm",
-			"com.android.overlay.gmscontactprovider",
-			"com.android.overlay.gmssettingprovider",
-			"com.android.overlay.gmssettings",
-			"com.android.overlay.gmstelecomm",
-			"com.android.overlay.gmstelephony",
-			"com.android.overlay.systemui",
-			"com.android.phone.overlay.miui",
-			"com.android.providers.settings.overlay",
-			"com.android.sdksandbox",
-			"com.android.settings.overlay.miui",
-			"com.android.stk.overlay.miui",
-			"com.android.systemui.gesture.line.overlay",
-			"com.android.systemui.navigation.bar.overlay",
-			"com.android.systemui.overlay.miui",
-			"com.android.wallpapercropper",
-			"com.android.wallpaperpicker",
-			"com.android.wifi.dialog",
-			"com.android.wifi.resources.overlay",
-			"com.android.wifi.resources.xiaomi",
-			"com.android.wifi.system.mainline.resources.overlay",
-			"com.android.wifi.system.resources.overlay",
-			"com.google.android.cellbroadcastreceiver.overlay.miui",
-			"com.google.android.cellbroadcastservice.overlay.miui",
-			"com.google.android.overlay.gmsconfig",
-			"com.google.android.overlay.modules.ext.services",
-			"com.google.android.trichromelibrary_511209734",
-			"com.google.android.trichromelibrary_541411734",
-			"com.mediatek.FrameworkResOverlayExt",
-			"com.mediatek.SettingsProviderResOverlay",
-			"com.mediatek.batterywarning",
-			"com.mediatek.cellbroadcastuiresoverlay",
-			"com.mediatek.frameworkresoverlay",
-			"com.mediatek.gbaservice",
-			"com.mediatek.voiceunlock",
-			"com.miui.core.internal.services",
-			"com.miui.face.overlay.miui",
-			"com.miui.miwallpaper.overlay.customize",
-			"com.miui.miwallpaper.wallpaperoverlay.config.overlay",
-			"com.miui.rom",
-			"com.miui.settings.rro.device.config.overlay",
-			"com.miui.settings.rro.device.hide.statusbar.overlay",
-			"com.miui.settings.rro.device.type.overlay",
-			"com.miui.system.overlay",
-			"com.miui.systemui.carriers.overlay",
-			"com.miui.systemui.devices.overlay",
-			"com.miui.systemui.overlay.devices.android",
-			"com.miui.translation.kingsoft",
-			"com.miui.translation.xmcloud",
-			"com.miui.translationservice",
-			"com.miui.voiceassistoverlay",
-			"com.miui.wallpaper.overlay.customize",
-			"com.xiaomi.bluetooth.rro.device.config.overlay",
-
-
-			"android.auto_generated_rro_product__",
-			"android.auto_generated_rro_vendor__",
-			"com.android.backupconfirm",
-			"com.android.carrierconfig.auto_generated_rro_vendor__",
-			"com.android.cts.ctsshim",
-			"com.android.cts.priv.ctsshim",
-			"com.android.documentsui.auto_generated_rro_product__",
-			"com.android.emergency.auto_generated_rro_product__",
-			"com.android.imsserviceentitlement",
-			"com.android.imsserviceentitlement.auto_generated_rro_product__",
-			"com.android.inputmethod.latin.auto_generated_rro_product__",
-			"com.android.launcher3.overlay",
-			"com.android.managedprovisioning.auto_generated_rro_product__",
-			"com.android.nearby.halfsheet",
-			"com.android.phone.auto_generated_rro_vendor__",
-			"com.android.providers.settings.auto_generated_rro_product__",
-			"com.android.providers.settings.auto_generated_rro_vendor__",
-			"com.android.settings.auto_generated_rro_product__",
-			"com.android.sharedstoragebackup",
-			"com.android.smspush",
-			"com.android.storagemanager.auto_generated_rro_product__",
-			"com.android.systemui.auto_generated_rro_product__",
-			"com.android.systemui.auto_generated_rro_vendor__",
-			"com.android.systemui.plugin.globalactions.wallet",
-			"com.android.wallpaper.auto_generated_rro_product__",
-			"com.android.wifi.resources.oneplus_sdm845",
-			"com.qualcomm.timeservice",
-			"lineageos.platform.auto_generated_rro_product__",
-			"lineageos.platform.auto_generated_rro_vendor__",
-			"org.codeaurora.ims",
-			"org.lineageos.aperture.auto_generated_rro_vendor__",
-			"org.lineageos.lineageparts.auto_generated_rro_product__",
-			"org.lineageos.lineagesettings.auto_generated_rro_product__",
-			"org.lineageos.lineagesettings.auto_generated_rro_vendor__",
-			"org.lineageos.overlay.customization.navbar.nohint",
-			"org.lineageos.settings.device.auto_generated_rro_product__",
-			"org.lineageos.settings.doze.auto_generated_rro_product__",
-			"org.lineageos.settings.doze.auto_generated_rro_vendor__",
-			"org.lineageos.setupwizard.auto_generated_rro_product__",
-			"org.lineageos.updater.auto_generated_rro_product__",
-			"org.protonaosp.deviceconfig.auto_generated_rro_product__",
+	// 应用表的读写(循环线程 工作线程)需持有该锁, 监控线程只标记变化, 由循环线程应用
+	mutex appListMutex;
+	atomic<bool> isWatching{ false };
+	atomic<bool> isAppListChanged{ false };
 
-	};
-
-	const unordered_set<string> whiteListDefault{
-		// "com.android.vending",                  // Play 商店
-		// "com.google.android.gms",               // GMS 服务
-		// "com.google.android.gsf",               // Google 服务框架
-		"com.mi.health",                        // 小米运动健康
-		"com.tencent.mm.wxa.sce",               // 微信小程序
-
-		"com.onlyone.onlyonestarter",           // 三星系应用
-		"com.samsung.accessory.neobeanmgr",     // Galaxy Buds Live Manager
-		"com.samsung.app.newtrim",              // 编辑器精简版
-		"com.diotek.sec.lookup.dictionary",     // 字典
-	};
+	// 日志渲染线程查询应用名称用的副本, 不能取 appListMutex(持有者会写日志)
+	mutex labelMutex;
+	UidTable<istr> labelView;
 
 public:
 
@@ -379,26 +48,42 @@ public:
 
 	ManagedApp& operator=(ManagedApp&&) = delete;
 
-	ManagedApp(Freezeit& freezeit, Settings& settings) : freezeit(freezeit), settings(settings) {
+	ManagedApp(Freezeit& freezeit, Settings& settings, ConfigStore& configStore) :
+		freezeit(freezeit), settings(settings), configStore(configStore) {
 		cfgPath = freezeit.modulePath + "/appcfg.txt";
 		labelPath = freezeit.modulePath + "/applabel.txt";
 
-		packageListBuff = make_unique<char[]>(PACKAGE_LIST_BUF_SIZE);
+		// 日志事件在读取时才渲染, 届时通过UID查询应用名称
+		freezeit.setLabelHook(this, [](void* ctx, int uid) -> const char* {
+			auto& app = *static_cast<ManagedApp*>(ctx);
+			lock_guard<mutex> lock(app.labelMutex);
+			const auto it = app.labelView.find(uid);
+			return it == app.labelView.end() ? nullptr : it->second.c_str();
+			});
 
 		updateAppList();
 		loadLabelFile();
+		publishLabels();
 
 		loadConfigFile2CfgTemp();
 		updateIME2CfgTemp();
 		applyCfgTemp();
 		update2xposedByLocalSocket();
+
+		if (configStore.isNew()) {
+			saveConfig();
+			saveLabel();
+			freezeit.log("应用配置及名称已迁移到配置库");
+		}
+
+		thread(&ManagedApp::watchPackagesListTask, this).detach();
 	}
 
 	auto& getRaw() { return infoMap; }
 
 	auto& operator[](const int& uid) { return infoMap[uid]; }
 
-	auto& operator[](const string& package) { return infoMap[uidIndex[package]]; }
+	auto& operator[](const string& package) { return infoMap[uidIndex[istr(package)]]; }
 
 	[[maybe_unused]] size_t erase(const int& uid) { return infoMap.erase(uid); }
 
@@ -408,18 +93,21 @@ public:
 
 	bool contains(const int& uid) { return infoMap.contains(uid); }
 
-	[[maybe_unused]] bool contains(const string& package) { return uidIndex.contains(package); }
+	[[maybe_unused]] bool contains(const string& package) { return uidIndex.contains(istr::find(package)); }
 
 	bool without(const int& uid) { return !infoMap.contains(uid); }
 
-	bool without(const string& package) { return !uidIndex.contains(package); }
+	bool without(const string& package) { return !uidIndex.contains(istr::find(package)); }
 
 	auto& getLabel(const int& uid) { return infoMap[uid].label; }
 
-	int getUid(const string& package) { return uidIndex[package]; }
+	int getUid(const string& package) { return uidIndex[istr(package)]; }
+
+	// 未入池的包名必然不在应用表中, 查找时不入池
+	auto findUid(const string_view package) { return uidIndex.find(istr::find(package)); }
 
 	[[maybe_unused]] int getUidOrDefault(const string& package, const int& defaultValue) {
-		auto it = uidIndex.find(package);
+		auto it = findUid(package);
 		return it != uidIndex.end() ? it->second : defaultValue;
 	}
 
@@ -427,7 +115,7 @@ public:
 
 	void updateHomePackage(const string& package) {
 		homePackage = package;
-		const auto& it = uidIndex.find(package);
+		const auto& it = findUid(package);
 		if (it == uidIndex.end()) {
 			freezeit.log("当前桌面信息异常，建议反馈: [%s]", package.c_str());
 			return;
@@ -437,63 +125,60 @@ public:
 		infoMap[uid].freezeMode = FREEZE_MODE::WHITEFORCE;
 	}
 
-	bool readPackagesListA12(map<int, string>& _allAppList, map<int, string>& _thirdAppList) {
-		START_TIME_COUNT;
+	// 每行: 包名 UID 调试标记 数据目录 SELinux信息 GID列表 ... A12+ 系统应用行尾为 @system
+	// 回调 func(string_view package, int uid, string_view line), 只给出范围内的应用UID
+	template<typename F>
+	bool scanPackagesList(F&& func) {
+		const LineScan::mappedFile file("/data/system/packages.list");
+		if (!file) return false;
 
-		stringstream ss;
-		ss << ifstream("/data/system/packages.list").rdbuf();
-
-		string_view sysEnd("@system");
-		string line;
-		while (getline(ss, line)) {
-			if (line.length() < 10) continue;
-			if (line.starts_with("com.google.android.trichromelibrary")) continue;
+		file.forEachLine([&](string_view line) {
+			if (line.length() < 10) return;
+			if (line.starts_with("com.google.android.trichromelibrary")) return;
 
+			string_view rest = line;
+			const string_view package = LineScan::nextField(rest, ' ');
 			int uid;
-			char package[256] = {};
-			sscanf(line.c_str(), "%s %d", package, &uid);
-			if (uid < 10000 || 12000 <= uid) continue;
+			if (!LineScan::parseInt(LineScan::nextField(rest, ' '), uid)) return;
+			if (uid < 10000 || 12000 <= uid) return;
+
+			func(package, uid, line);
+			});
+		return true;
+	}
 
-			const string& packageName{ package };
-			_allAppList[uid] = packageName;
-			if (!line.ends_with(sysEnd))
+	bool readPackagesListA12(map<int, string>& _allAppList, map<int, string>& _thirdAppList) {
+		TRACE_SCOPE;
+
+		scanPackagesList([&](const string_view package, const int uid, const string_view line) {
+			auto& packageName = _allAppList[uid];
+			packageName = package;
+			if (!line.ends_with("@system"))
 				_thirdAppList[uid] = packageName;
-		}
-		END_TIME_COUNT;
+			});
 		return _allAppList.size() > 0;
 	}
 
 	bool readPackagesListA10_11(map<int, string>& _allAppList) {
-		START_TIME_COUNT;
-
-		stringstream ss;
-		ss << ifstream("/data/system/packages.list").rdbuf();
-
-		string line;
-		while (getline(ss, line)) {
-			if (line.length() < 10) continue;
-			if (line.starts_with("com.google.android.trichromelibrary")) continue;
-
-			int uid;
-			char package[256] = {};
-			sscanf(line.c_str(), "%s %d", package, &uid);
-			if (uid < 10000 || 12000 <= uid) continue;
+		TRACE_SCOPE;
 
+		scanPackagesList([&](const string_view package, const int uid, const string_view) {
 			_allAppList[uid] = package;
-		}
-		END_TIME_COUNT;
+			});
 		return _allAppList.size() > 0;
 	}
 
 	void readCmdPackagesAll(map<int, string>& _allAppList) {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 		stringstream ss;
 		string line;
 
 		const char* cmdList[] = { "/system/bin/cmd", "cmd", "package", "list", "packages", "-U",
 								 nullptr };
-		VPOPEN::vpopen(cmdList[0], cmdList + 1, packageListBuff.get(), PACKAGE_LIST_BUF_SIZE);
-		ss << packageListBuff.get();
+		auto packageListBuf = BufferPool::acquire(PACKAGE_LIST_BUF_SIZE, BufferPool::OWNER_MANAGED_APP);
+		if (!packageListBuf) return;
+		VPOPEN::vpopen(cmdList[0], cmdList + 1, packageListBuf.data(), PACKAGE_LIST_BUF_SIZE);
+		ss << packageListBuf.data();
 		while (getline(ss, line)) {
 			// package:com.google.android.GoogleCameraGood uid:10364
 			if (!Utils::startWith("package:", line.c_str()))continue;
@@ -504,18 +189,19 @@ public:
 			if (idx < 10 || uid < 10000 || 12000 <= uid) continue;
 			_allAppList[uid] = line.substr(8, idx - 8); //package
 		}
-		END_TIME_COUNT;
 	}
 
 	void readCmdPackagesThird(map<int, string>& _thirdAppList) {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 		stringstream ss;
 		string line;
 
 		const char* cmdList[] = { "/system/bin/cmd", "cmd", "package", "list", "packages", "-3",
 								 "-U", nullptr };
-		VPOPEN::vpopen(cmdList[0], cmdList + 1, packageListBuff.get(), PACKAGE_LIST_BUF_SIZE);
-		ss << packageListBuff.get();
+		auto packageListBuf = BufferPool::acquire(PACKAGE_LIST_BUF_SIZE, BufferPool::OWNER_MANAGED_APP);
+		if (!packageListBuf) return;
+		VPOPEN::vpopen(cmdList[0], cmdList + 1, packageListBuf.data(), PACKAGE_LIST_BUF_SIZE);
+		ss << packageListBuf.data();
 		while (getline(ss, line)) {
 			// package:com.google.android.GoogleCameraGood uid:10364
 			if (!Utils::startWith("package:", line.c_str()))continue;
@@ -526,12 +212,109 @@ public:
 			if (idx < 10 || uid < 10000 || 12000 <= uid) continue;
 			_thirdAppList[uid] = line.substr(8, idx - 8); //package
 		}
-		END_TIME_COUNT;
 	}
 
-	// 开机，更新冻结配置，更新应用名称，都会调用
+	void addApp(const int uid, const istr& package, const bool isSYS) {
+		infoMap[uid] = {
+				isSYS ? FREEZE_MODE::WHITELIST : FREEZE_MODE::FREEZER, //freezeMode
+				true,       // isTolerant
+				0,       // failFreezeCnt
+				isSYS,   // isSystemApp
+				0,       // startRunningTime
+				0,       // totalRunningTime
+				package, // package
+				package, // label
+				{}
+		};
+	}
+
+	// 与当前应用表按 (UID, 包名) 比较, 只增删有变化的应用, 返回是否有变化
+	// 需持有 appListMutex
+	bool refreshChangedApps() {
+		TRACE_SCOPE;
+
+		map<int, string> allAppList, thirdAppList;
+		const bool isReadOk = freezeit.SDK_INT_VER >= 31 ?
+			readPackagesListA12(allAppList, thirdAppList) : readPackagesListA10_11(allAppList);
+		if (!isReadOk) return false;
+
+		string removedLabel, addedLabel;
+		for (auto it = infoMap.begin(); it != infoMap.end();) {
+			auto newIt = allAppList.find(it->first);
+			if (newIt != allAppList.end() && newIt->second == it->second.package) {
+				it++;
+				continue;
+			}
+			removedLabel += " [" + it->second.label + "]";
+			uidIndex.erase(it->second.package);
+			it = infoMap.erase(it);
+		}
+
+		vector<int> addedUids;
+		for (const auto& [uid, package] : allAppList)
+			if (!infoMap.contains(uid)) addedUids.emplace_back(uid);
+
+		if (addedUids.size() && freezeit.SDK_INT_VER < 31)
+			readCmdPackagesThird(thirdAppList); // A10/11 的 packages.list 无系统应用标记
+
+		for (const int uid : addedUids) {
+			const istr package(allAppList[uid]);
+			uidIndex[package] = uid;
+			addApp(uid, package, !thirdAppList.contains(uid));
+			addedLabel += " [" + package + "]";
+		}
+
+		if (addedLabel.length())
+			freezeit.log("新安装应用:%s", addedLabel.c_str());
+		if (removedLabel.length())
+			freezeit.log("已卸载应用:%s", removedLabel.c_str());
+		if (addedLabel.empty() && removedLabel.empty())
+			return false;
+
+		collectStrings();
+		return true;
+	}
+
+	// packages.list 由临时文件改名覆盖, 因此监控所在目录, 按文件名过滤
+	void watchPackagesListTask() {
+		constexpr int WATCH_BUF_SIZE = 4096;
+		constexpr char PACKAGES_LIST_DIR[] = "/data/system";
+		constexpr char PACKAGES_LIST_NAME[] = "packages.list";
+
+		Trace::setThreadName("pkgwatch");
+
+		const int inotifyFd = inotify_init1(IN_CLOEXEC);
+		if (inotifyFd < 0) {
+			freezeit.log("监控应用列表失败, 安装应用后需手动更新应用列表 [%d]:[%s]", errno, strerror(errno));
+			return;
+		}
+		if (inotify_add_watch(inotifyFd, PACKAGES_LIST_DIR, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+			freezeit.log("监控应用列表失败, 安装应用后需手动更新应用列表 [%d]:[%s]", errno, strerror(errno));
+			close(inotifyFd);
+			return;
+		}
+		isWatching = true;
+
+		alignas(inotify_event) char buf[WATCH_BUF_SIZE];
+		ssize_t readLen;
+		while ((readLen = read(inotifyFd, buf, sizeof(buf))) > 0) {
+			bool isChanged = false;
+			for (ssize_t offset = 0; offset < readLen;) {
+				const auto event = reinterpret_cast<const inotify_event*>(buf + offset);
+				if (event->len && !strcmp(event->name, PACKAGES_LIST_NAME)) isChanged = true;
+				offset += sizeof(inotify_event) + event->len;
+			}
+			if (isChanged) isAppListChanged = true;
+		}
+
+		isWatching = false;
+		close(inotifyFd);
+		freezeit.log("已退出监控应用列表");
+	}
+
+	// 开机 或无法监控 packages.list 时完整刷新
 	void updateAppList() {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
 		map<int, string> allAppList, thirdAppList;
 
@@ -557,73 +340,127 @@ public:
 				thirdAppList.size());
 		}
 
-		uidIndex.clear();
-		for (const auto& [uid, package] : allAppList) {
-			uidIndex[package] = uid;        // 更新 按包名取UID
-			if (infoMap.contains(uid))continue;
-
-			const bool isSYS = !thirdAppList.contains(uid);
-			infoMap[uid] = {
-					isSYS ? FREEZE_MODE::WHITELIST : FREEZE_MODE::FREEZER, //freezeMode
-					true,       // isTolerant
-					0,       // failFreezeCnt
-					isSYS,   // isSystemApp
-					0,       // startRunningTime
-					0,       // totalRunningTime
-					package, // package
-					package, // label
-					{}
-			};
-		}
-
-		// 移除已卸载应用
+		// 移除已卸载的应用, 以及UID被其他包名复用的
 		for (auto it = infoMap.begin(); it != infoMap.end();) {
-			if (allAppList.contains(it->first))it++;
+			auto newIt = allAppList.find(it->first);
+			if (newIt != allAppList.end() && newIt->second == it->second.package) it++;
 			else it = infoMap.erase(it);
 		}
-		END_TIME_COUNT;
+
+		uidIndex.clear();
+		for (const auto& [uid, packageName] : allAppList) {
+			const istr package(packageName);
+			uidIndex[package] = uid;        // 更新 按包名取UID
+			if (!infoMap.contains(uid))
+				addApp(uid, package, !thirdAppList.contains(uid));
+		}
+		collectStrings();
+	}
+
+	// 循环线程每秒调用, 应用监控到的 packages.list 变化
+	// 需持有 lockAppList()
+	void applyAppListChange() {
+		if (!isAppListChanged.exchange(false)) return;
+
+		if (refreshChangedApps()) {
+			applyCfgTemp();
+			update2xposedByLocalSocket();
+		}
+	}
+
+	void publishLabels() {
+		lock_guard<mutex> lock(labelMutex);
+		labelView.clear();
+		for (const auto& [uid, info] : infoMap)
+			labelView[uid] = info.label;
 	}
 
+	// 应用表、名称变化后调用, 更新日志用的名称副本, 回收字符串池中不再使用的包名/名称
+	void collectStrings() {
+		publishLabels();
+		if (StrArena::collect([&](auto&& mark) {
+			for (const auto& [uid, info] : infoMap) {
+				mark(info.package);
+				mark(info.label);
+			}
+			for (const auto& [package, uid] : uidIndex)
+				mark(package);
+			}))
+			freezeit.log("字符串池已回收");
+	}
+
+	// 修改配置/名称的命令调用: 正在监控 packages.list 时应用表已是最新, 否则完整刷新
+	// 需持有 lockAppList()
+	void syncAppList() {
+		if (!isWatching) updateAppList();
+	}
+
+	[[nodiscard]] std::unique_lock<mutex> lockAppList() { return std::unique_lock<mutex>(appListMutex); }
+
+	// 配置库值: [冻结模式, 宽容]
 	void loadConfigFile2CfgTemp() {
 		cfgTemp.clear();
 
-		ifstream file(cfgPath);
-		if (!file.is_open())
+		if (!configStore.isNew()) {
+			configStore.forEach(ConfigStore::SECTION_APP_CFG, [&](const string_view package, const string_view value) {
+				auto it = findUid(package);
+				if (it == uidIndex.end() || value.length() != 2) return;
+
+				const FREEZE_MODE freezeMode = static_cast<FREEZE_MODE>(static_cast<uint8_t>(value[0]));
+				if (!FREEZE_MODE_SET.contains(freezeMode)) {
+					freezeit.log("C配置错误: [%.*s] %d", static_cast<int>(package.length()), package.data(),
+						static_cast<int>(freezeMode));
+					return;
+				}
+				cfgTemp[it->second] = { freezeMode, value[1] != 0 };
+				});
 			return;
+		}
 
-		string line;
-		while (getline(file, line)) {
+		// 旧版 appcfg.txt
+		const LineScan::mappedFile file(cfgPath.c_str());
+		if (!file)
+			return;
+
+		file.forEachLine([&](const string_view line) { // 包名或UID 冻结模式 宽容
+			const int lineLen = static_cast<int>(line.length());
 			if (line.length() <= 4) {
-				freezeit.log("A配置错误: [%s]", line.c_str());
-				continue;
+				freezeit.log("A配置错误: [%.*s]", lineLen, line.data());
+				return;
 			}
 
-			auto value = Utils::splitString(line, " ");
-			if (value.size() != 3 || value[0].empty()) {
-				freezeit.log("B配置错误: [%s]", line.c_str());
-				continue;
+			string_view rest = line;
+			const string_view key = LineScan::nextField(rest, ' ');
+			const string_view modeField = LineScan::nextField(rest, ' ');
+			const string_view tolerantField = LineScan::nextField(rest, ' ');
+			int mode, tolerant;
+			if (key.empty() || !LineScan::nextField(rest, ' ').empty() ||
+				!LineScan::parseInt(modeField, mode) || !LineScan::parseInt(tolerantField, tolerant)) {
+				freezeit.log("B配置错误: [%.*s]", lineLen, line.data());
+				return;
 			}
 
 			int uid;
-			if (isdigit(value[0][0])) {
-				uid = atoi(value[0].c_str());
+			if (isdigit(key[0])) {
+				if (!LineScan::parseInt(key, uid)) {
+					freezeit.log("B配置错误: [%.*s]", lineLen, line.data());
+					return;
+				}
 			}
 			else {
-				auto it = uidIndex.find(value[0]);
-				if (it == uidIndex.end())continue;
+				auto it = findUid(key);
+				if (it == uidIndex.end())return;
 				uid = it->second;
 			}
-			const FREEZE_MODE freezeMode = static_cast<FREEZE_MODE>(atoi(value[1].c_str()));
-			const bool isTolerant = atoi(value[2].c_str()) != 0;
+			const FREEZE_MODE freezeMode = static_cast<FREEZE_MODE>(mode);
 
 			if (!FREEZE_MODE_SET.contains(freezeMode)) {
-				freezeit.log("C配置错误: [%s]", line.c_str());
-				continue;
+				freezeit.log("C配置错误: [%.*s]", lineLen, line.data());
+				return;
 			}
 
-			cfgTemp[uid] = { freezeMode, isTolerant };
-		}
-		file.close();
+			cfgTemp[uid] = { freezeMode, tolerant != 0 };
+			});
 	}
 
 	void loadConfig2CfgTemp(map<int, cfgStruct>& newCfg) {
@@ -647,34 +484,16 @@ public:
 			const string& package = line.substr(0, idx);
 			if (package.length() < 6) continue;
 
-			auto it = uidIndex.find(package);
+			auto it = findUid(package);
 			if (it == uidIndex.end()) continue;
 
 			cfgTemp[it->second] = { FREEZE_MODE::WHITEFORCE, 0 };
 		}
 	}
 
-	bool isSystemApp(const char* ptr) {
-		const char* prefix[] = {
-				"com.miui.",
-				"com.oplus.",
-				"com.coloros.",
-				"com.heytap.",
-				"com.samsung.android.",
-				"com.samsung.systemui.",
-				"com.android.samsung.",
-				"com.sec.android.",
-		};
-		for (size_t i = 0; i < sizeof(prefix) / sizeof(prefix[0]); i++) {
-			if (Utils::startWith(prefix[i], ptr))
-				return true;
-		}
-		return false;
-	}
-
 	void applyCfgTemp() {
 		for (auto& [uid, info] : infoMap) {
-			if (isSystemApp(info.package.c_str()) || whiteListDefault.contains(info.package))
+			if (Whitelist::isSystemApp(info.package) || Whitelist::isDefault(info.package))
 				info.freezeMode = FREEZE_MODE::WHITELIST;
 		}
 
@@ -687,31 +506,29 @@ public:
 		}
 
 		for (auto& [uid, info] : infoMap) {
-			if (whiteListForce.contains(info.package))
+			if (Whitelist::isForce(info.package))
 				info.freezeMode = FREEZE_MODE::WHITEFORCE;
 		}
 
 		if (homePackage.length() > 3) {
-			auto it = uidIndex.find(homePackage);
+			auto it = findUid(homePackage);
 			if (it != uidIndex.end())
 				infoMap[it->second].freezeMode = FREEZE_MODE::WHITEFORCE;
 		}
 	}
 
+	// 配置库只追加有变化的应用
 	void saveConfig() {
-		char buf[1024 * 64];
-		size_t len = 0;
+		ConfigStore::sectionMap section;
 		for (const auto& [uid, cfg] : infoMap)
 			if (cfg.freezeMode < FREEZE_MODE::WHITEFORCE)
-				STRNCAT(buf, len, "%s %d %d\n",
-					cfg.package.c_str(),
-					static_cast<int>(cfg.freezeMode),
-					cfg.isTolerant ? 1 : 0);
+				section.emplace(cfg.package.view(), string{ static_cast<char>(cfg.freezeMode),
+					static_cast<char>(cfg.isTolerant ? 1 : 0) });
 
-		if (Utils::writeString(cfgPath.c_str(), buf, len))
+		if (configStore.replaceSection(ConfigStore::SECTION_APP_CFG, std::move(section)))
 			freezeit.log("保存配置成功");
 		else
-			freezeit.log("保存配置文件失败: [%s]", cfgPath.c_str());
+			freezeit.log("保存配置失败");
 	}
 
 	void update2xposedByLocalSocket() {
@@ -785,43 +602,56 @@ public:
 	}
 
 	void loadLabelFile() {
-		ifstream file(labelPath);
+		if (!configStore.isNew()) {
+			configStore.forEach(ConfigStore::SECTION_APP_LABEL, [&](const string_view package, const string_view label) {
+				auto it = findUid(package);
+				if (it != uidIndex.end())
+					infoMap[it->second].label = label;
+				});
+			return;
+		}
 
-		if (!file.is_open()) {
+		// 旧版 applabel.txt
+		const LineScan::mappedFile file(labelPath.c_str());
+
+		if (!file) {
 			freezeit.log("读取应用名称文件失败: [%s]", labelPath.c_str());
 			return;
 		}
 
-		string line;
-		while (getline(file, line)) {
+		constexpr string_view LABEL_DELIM("####");
+		file.forEachLine([&](const string_view line) {
+			const int lineLen = static_cast<int>(line.length());
 			if (line.length() <= 2) {
-				freezeit.log("读取到错误包名: [%s]", line.c_str());
-				continue;
+				freezeit.log("读取到错误包名: [%.*s]", lineLen, line.data());
+				return;
 			}
 
 			if (isalpha(line[0])) {// package####label
-				auto value = Utils::splitString(line, "####");
-				if (value.size() != 2) {
-					freezeit.log("分割错误: [%s]", line.c_str());
-					continue;
+				const size_t delimIdx = line.find(LABEL_DELIM);
+				const string_view label = delimIdx == string_view::npos ?
+					string_view() : line.substr(delimIdx + LABEL_DELIM.length());
+				if (label.empty() || label.find(LABEL_DELIM) != string_view::npos) {
+					freezeit.log("分割错误: [%.*s]", lineLen, line.data());
+					return;
 				}
-				auto it = uidIndex.find(value[0]);
+				auto it = findUid(line.substr(0, delimIdx));
 				if (it != uidIndex.end())
-					infoMap[it->second].label = value[1];
+					infoMap[it->second].label = label;
 			}
 			else if (isdigit(line[0])) {  // uid label
-				int uid = atoi(line.c_str());
+				string_view rest = line;
+				int uid;
+				if (!LineScan::parseInt(LineScan::nextField(rest, ' '), uid)) return;
 
 				auto it = infoMap.find(uid);
 				if (it != infoMap.end() && line.length() > 6)
 					it->second.label = line.substr(6);
 			}
 			else {
-				freezeit.log("读取到错误包名: [%s]", line.c_str());
-				continue;
+				freezeit.log("读取到错误包名: [%.*s]", lineLen, line.data());
 			}
-		}
-		file.close();
+			});
 	}
 
 	void loadLabel(const map<int, string>& labelList) {
@@ -830,26 +660,17 @@ public:
 			if (it != infoMap.end())
 				it->second.label = label;
 		}
+		collectStrings();
 	}
 
 	void saveLabel() {
-		auto fd = open(labelPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
-		if (fd < 0) {
-			freezeit.log("保存应用名称文件失败: [%s]", labelPath.c_str());
-			return;
-		}
-
-		string tmp;
-		tmp.reserve(1024L * 16);
+		ConfigStore::sectionMap section;
 		for (const auto& [uid, info] : infoMap)
-			if (info.package != info.label) {
-				tmp += info.package;
-				tmp += "####";
-				tmp += info.label;
-				tmp += '\n';
-			}
-		write(fd, tmp.c_str(), tmp.length());
-		close(fd);
+			if (info.package != info.label)
+				section.emplace(info.package.view(), info.label.view());
+
+		if (!configStore.replaceSection(ConfigStore::SECTION_APP_LABEL, std::move(section)))
+			freezeit.log("保存应用名称失败");
 	}
 
 
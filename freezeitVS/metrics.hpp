@@ -0,0 +1,295 @@
+#pragma once
+
+#include "utils.hpp"
+#include "trace.hpp"
+
+// 运行指标: 计数器/仪表/直方图, 全部为原子变量, 可在任意线程更新
+// 导出格式 Prometheus 文本, 或紧凑二进制:
+//   每条序列 [u8 type][u8 nameLen][name][u8 labelLen][label][u8 valueCnt][int64 value * valueCnt]
+//   直方图 value 依次为 count, sum(us), 各桶累计值(上界见 HIST_BOUNDS_US, 最后一个为 +Inf)
+namespace Metrics {
+
+	enum class TYPE : uint8_t {
+		COUNTER = 0,
+		GAUGE = 1,
+		HISTOGRAM = 2,
+	};
+
+	constexpr uint64_t HIST_BOUNDS_US[] = { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000,
+		100000, 1000000 };
+	constexpr int HIST_BUCKET_CNT = sizeof(HIST_BOUNDS_US) / sizeof(HIST_BOUNDS_US[0]) + 1;
+
+	class metricBase;
+	inline atomic<metricBase*> metricList{ nullptr };
+
+	class metricBase {
+	public:
+		const char* name;
+		const char* help;
+		TYPE type;
+		metricBase* next = nullptr;
+
+		metricBase(const char* _name, const char* _help, const TYPE _type) :
+			name(_name), help(_help), type(_type) {
+			next = metricList.load(std::memory_order_relaxed);
+			while (!metricList.compare_exchange_weak(next, this, std::memory_order_release,
+				std::memory_order_relaxed));
+		}
+
+		virtual ~metricBase() = default;
+
+		virtual size_t formatText(char* buf, size_t maxLen) const = 0;
+		virtual size_t formatBinary(char* buf, size_t maxLen) const = 0;
+
+	protected:
+		// labelValues 为空则以下标作为标签值, 此时值为0的序列不输出
+		static const char* labelText(const char* const* labelValues, const int idx, char* tmp) {
+			if (labelValues) return labelValues[idx];
+			snprintf(tmp, 16, "%d", idx);
+			return tmp;
+		}
+
+		static size_t binarySeries(char* buf, const size_t maxLen, const TYPE type, const char* name,
+			const char* label, const int64_t* values, const int valueCnt) {
+			const size_t nameLen = std::min(strlen(name), (size_t)255);
+			const size_t labelLen = std::min(strlen(label), (size_t)255);
+			const size_t len = 4 + nameLen + labelLen + valueCnt * sizeof(int64_t);
+			if (len > maxLen) return 0;
+
+			size_t idx = 0;
+			buf[idx++] = static_cast<char>(type);
+			buf[idx++] = static_cast<char>(nameLen);
+			memcpy(buf + idx, name, nameLen);
+			idx += nameLen;
+			buf[idx++] = static_cast<char>(labelLen);
+			memcpy(buf + idx, label, labelLen);
+			idx += labelLen;
+			buf[idx++] = static_cast<char>(valueCnt);
+			memcpy(buf + idx, values, valueCnt * sizeof(int64_t));
+			return len;
+		}
+	};
+
+	template<int N>
+	class counterVec : public metricBase {
+	private:
+		const char* labelName;
+		const char* const* labelValues;
+		atomic<uint64_t> value[N]{};
+
+	public:
+		counterVec(const char* _name, const char* _help, const char* _labelName = nullptr,
+			const char* const* _labelValues = nullptr) :
+			metricBase(_name, _help, TYPE::COUNTER), labelName(_labelName), labelValues(_labelValues) {}
+
+		void inc(const int idx = 0, const uint64_t n = 1) {
+			if (0 <= idx && idx < N)
+				value[idx].fetch_add(n, std::memory_order_relaxed);
+		}
+
+		size_t formatText(char* buf, size_t maxLen) const override {
+			size_t len = snprintf(buf, maxLen, "# HELP %s %s\n# TYPE %s counter\n", name, help, name);
+			char tmp[16];
+			for (int i = 0; i < N && len < maxLen; i++) {
+				const uint64_t v = value[i].load(std::memory_order_relaxed);
+				if (!labelName)
+					len += snprintf(buf + len, maxLen - len, "%s %lu\n", name, (unsigned long)v);
+				else if (labelValues || v)
+					len += snprintf(buf + len, maxLen - len, "%s{%s=\"%s\"} %lu\n", name, labelName,
+						labelText(labelValues, i, tmp), (unsigned long)v);
+			}
+			return std::min(len, maxLen);
+		}
+
+		size_t formatBinary(char* buf, size_t maxLen) const override {
+			size_t len = 0;
+			char tmp[16];
+			for (int i = 0; i < N; i++) {
+				const int64_t v = value[i].load(std::memory_order_relaxed);
+				if (labelName && !labelValues && !v) continue;
+				len += binarySeries(buf + len, maxLen - len, type, name,
+					labelName ? labelText(labelValues, i, tmp) : "", &v, 1);
+			}
+			return len;
+		}
+	};
+
+	using counter = counterVec<1>;
+
+	class gauge : public metricBase {
+	private:
+		atomic<int64_t> value{ 0 };
+
+	public:
+		gauge(const char* _name, const char* _help) : metricBase(_name, _help, TYPE::GAUGE) {}
+
+		void set(const int64_t v) { value.store(v, std::memory_order_relaxed); }
+		void add(const int64_t n) { value.fetch_add(n, std::memory_order_relaxed); }
+
+		size_t formatText(char* buf, size_t maxLen) const override {
+			return std::min(maxLen, (size_t)snprintf(buf, maxLen, "# HELP %s %s\n# TYPE %s gauge\n%s %ld\n",
+				name, help, name, name, (long)value.load(std::memory_order_relaxed)));
+		}
+
+		size_t formatBinary(char* buf, size_t maxLen) const override {
+			const int64_t v = value.load(std::memory_order_relaxed);
+			return binarySeries(buf, maxLen, type, name, "", &v, 1);
+		}
+	};
+
+	struct histData {
+		atomic<uint64_t> bucket[HIST_BUCKET_CNT]{};
+		atomic<uint64_t> count{ 0 };
+		atomic<uint64_t> sumUs{ 0 };
+
+		void observe(const uint64_t us) {
+			int idx = 0;
+			while (idx < HIST_BUCKET_CNT - 1 && us > HIST_BOUNDS_US[idx]) idx++;
+			bucket[idx].fetch_add(1, std::memory_order_relaxed);
+			count.fetch_add(1, std::memory_order_relaxed);
+			sumUs.fetch_add(us, std::memory_order_relaxed);
+		}
+	};
+
+	template<int N>
+	class histogramVec : public metricBase {
+	private:
+		const char* labelName;
+		const char* const* labelValues;
+		histData data[N];
+
+	public:
+		histogramVec(const char* _name, const char* _help, const char* _labelName = nullptr,
+			const char* const* _labelValues = nullptr) :
+			metricBase(_name, _help, TYPE::HISTOGRAM), labelName(_labelName), labelValues(_labelValues) {}
+
+		histData& at(const int idx = 0) {
+			return data[(0 <= idx && idx < N) ? idx : 0];
+		}
+
+		size_t formatText(char* buf, size_t maxLen) const override {
+			size_t len = snprintf(buf, maxLen, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name);
+			char tmp[16], label[64];
+			for (int i = 0; i < N && len < maxLen; i++) {
+				const uint64_t cnt = data[i].count.load(std::memory_order_relaxed);
+				if (labelName && !labelValues && !cnt) continue;
+
+				if (labelName)
+					snprintf(label, sizeof(label), "%s=\"%s\",", labelName, labelText(labelValues, i, tmp));
+				else
+					label[0] = 0;
+
+				uint64_t sum = 0;
+				for (int b = 0; b < HIST_BUCKET_CNT && len < maxLen; b++) {
+					sum += data[i].bucket[b].load(std::memory_order_relaxed);
+					if (b < HIST_BUCKET_CNT - 1)
+						len += snprintf(buf + len, maxLen - len, "%s_bucket{%sle=\"%lu\"} %lu\n", name, label,
+							(unsigned long)HIST_BOUNDS_US[b], (unsigned long)sum);
+					else
+						len += snprintf(buf + len, maxLen - len, "%s_bucket{%sle=\"+Inf\"} %lu\n", name, label,
+							(unsigned long)sum);
+				}
+				if (len >= maxLen) break;
+
+				if (label[0]) label[strlen(label) - 1] = 0; // 去掉末尾逗号
+				const char* lb = label[0] ? "{" : "";
+				const char* rb = label[0] ? "}" : "";
+				len += snprintf(buf + len, maxLen - len, "%s_sum%s%s%s %lu\n%s_count%s%s%s %lu\n",
+					name, lb, label, rb, (unsigned long)data[i].sumUs.load(std::memory_order_relaxed),
+					name, lb, label, rb, (unsigned long)cnt);
+			}
+			return std::min(len, maxLen);
+		}
+
+		size_t formatBinary(char* buf, size_t maxLen) const override {
+			size_t len = 0;
+			char tmp[16];
+			int64_t values[HIST_BUCKET_CNT + 2];
+			for (int i = 0; i < N; i++) {
+				values[0] = data[i].count.load(std::memory_order_relaxed);
+				if (labelName && !labelValues && !values[0]) continue;
+
+				values[1] = data[i].sumUs.load(std::memory_order_relaxed);
+				int64_t sum = 0;
+				for (int b = 0; b < HIST_BUCKET_CNT; b++) {
+					sum += data[i].bucket[b].load(std::memory_order_relaxed);
+					values[2 + b] = sum;
+				}
+				len += binarySeries(buf + len, maxLen - len, type, name,
+					labelName ? labelText(labelValues, i, tmp) : "", values, HIST_BUCKET_CNT + 2);
+			}
+			return len;
+		}
+	};
+
+	using histogram = histogramVec<1>;
+
+	// 作用域计时, 析构或 stop() 时记录耗时(us)
+	class scopedTimer {
+	private:
+		histData* hist;
+		uint64_t startNs;
+
+	public:
+		explicit scopedTimer(histData& _hist) : hist(&_hist), startNs(Trace::nowNs()) {}
+
+		~scopedTimer() { stop(); }
+
+		void stop() {
+			if (!hist) return;
+			hist->observe((Trace::nowNs() - startNs) / 1000);
+			hist = nullptr;
+		}
+
+		scopedTimer(const scopedTimer&) = delete;
+		scopedTimer& operator=(const scopedTimer&) = delete;
+	};
+
+	inline size_t formatText(char* buf, const size_t maxLen) {
+		size_t len = 0;
+		for (auto it = metricList.load(std::memory_order_acquire); it && len < maxLen; it = it->next)
+			len += it->formatText(buf + len, maxLen - len);
+		return len;
+	}
+
+	inline size_t formatBinary(char* buf, const size_t maxLen) {
+		size_t len = 0;
+		for (auto it = metricList.load(std::memory_order_acquire); it; it = it->next)
+			len += it->formatBinary(buf + len, maxLen - len);
+		return len;
+	}
+
+	// 冻结后端: 0-5 同 WORK_MODE(Freezer模式), 6 SIGSTOP模式, 7 杀死后台
+	constexpr int BACKEND_SIGNAL = 6;
+	constexpr int BACKEND_TERMINATE = 7;
+	constexpr int BACKEND_CNT = 8;
+	inline const char* const BACKEND_LABEL[BACKEND_CNT] = {
+		"GLOBAL_SIGSTOP", "V1F", "V1UID", "V1F_ST", "V2UID", "V2FROZEN", "SIGNAL", "TERMINATE",
+	};
+
+	inline const char* const LOG_SINK_LABEL[2] = { "mem", "file" };
+
+	inline counterVec<BACKEND_CNT> freezeTotal("freezeit_freeze_total", "应用冻结次数",
+		"backend", BACKEND_LABEL);
+	inline counterVec<BACKEND_CNT> thawTotal("freezeit_thaw_total", "应用解冻次数",
+		"backend", BACKEND_LABEL);
+	inline counterVec<BACKEND_CNT> failTotal("freezeit_freeze_fail_total", "冻结/解冻失败的进程数",
+		"backend", BACKEND_LABEL);
+	inline counter binderDeferTotal("freezeit_binder_defer_total", "Binder正在传输而延迟冻结的次数");
+	inline gauge pendingApps("freezeit_pending_apps", "待冻结应用数");
+
+	inline histogram foregroundQuery("freezeit_foreground_query_us", "前台应用查询耗时");
+	inline counter foregroundQueryFail("freezeit_foreground_query_fail_total", "前台应用查询失败次数");
+	inline histogram procScan("freezeit_proc_scan_us", "遍历 /proc 耗时");
+
+	inline counterVec<2> logBytesTotal("freezeit_log_bytes_total", "日志写入字节数",
+		"sink", LOG_SINK_LABEL);
+
+	constexpr int SERVER_CMD_CNT = 128;
+	inline histogramVec<SERVER_CMD_CNT> serverRequest("freezeit_server_request_us",
+		"服务端命令处理耗时(含发送)", "cmd");
+	inline counterVec<SERVER_CMD_CNT> replyCacheHit("freezeit_reply_cache_hit_total",
+		"命令回应缓存命中次数", "cmd");
+	inline counterVec<SERVER_CMD_CNT> replyCacheMiss("freezeit_reply_cache_miss_total",
+		"命令回应缓存未命中次数", "cmd");
+}
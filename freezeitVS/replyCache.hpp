@@ -0,0 +1,61 @@
+#pragma once
+
+#include "utils.hpp"
+#include "trace.hpp"
+
+// 命令回应缓存: 以 命令+参数 为键, 保存完整回应数据, 到期或被 invalidate() 后失效
+// 通信线程与工作线程共用
+class ReplyCache {
+private:
+	constexpr static size_t MAX_ENTRY = 16;
+	constexpr static size_t MAX_REPLY_LEN = 1 << 20; // 过大的回应不缓存
+
+	struct cacheEntry {
+		int command;
+		string key;
+		uint64_t expireNs;
+		string reply;
+	};
+
+	mutex cacheMutex;
+	vector<cacheEntry> entries;
+
+public:
+	ReplyCache() { entries.reserve(MAX_ENTRY); }
+
+	static bool isStorable(const size_t replyLen) { return replyLen <= MAX_REPLY_LEN; }
+
+	// 命中则复制回应到 reply
+	bool lookup(const int command, const string& key, string& reply) {
+		const uint64_t now = Trace::nowNs();
+		lock_guard<mutex> lock(cacheMutex);
+		for (const auto& entry : entries) {
+			if (entry.command == command && entry.key == key && now < entry.expireNs) {
+				reply = entry.reply;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void store(const int command, const string& key, const string& reply, const uint32_t ttlMs) {
+		if (!isStorable(reply.length())) return;
+
+		const uint64_t now = Trace::nowNs();
+		lock_guard<mutex> lock(cacheMutex);
+		std::erase_if(entries, [&](const cacheEntry& entry) {
+			return now >= entry.expireNs || (entry.command == command && entry.key == key);
+			});
+		if (entries.size() >= MAX_ENTRY) {
+			entries.erase(std::min_element(entries.begin(), entries.end(),
+				[](const cacheEntry& a, const cacheEntry& b) { return a.expireNs < b.expireNs; }));
+		}
+		entries.emplace_back(cacheEntry{ command, key, now + ttlMs * 1'000'000ULL, reply });
+	}
+
+	// 配置/设置/日志变化后调用
+	void invalidate() {
+		lock_guard<mutex> lock(cacheMutex);
+		entries.clear();
+	}
+};
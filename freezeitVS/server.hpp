@@ -6,6 +6,7 @@
 #include "systemTools.hpp"
 #include "freezer.hpp"
 #include "doze.hpp"
+#include "replyCache.hpp"
 
 class Server {
 private:
@@ -16,11 +17,182 @@ private:
 	Freezer& freezer;
 	Doze& doze;
 
-	thread serverThread;
+	thread serverThread, workerThread;
 
-	static const int RECV_BUF_SIZE = 2 * 1024 * 1024;  // 2 MiB TCP通信接收缓存大小
+	static const int RECV_BUF_SIZE = 2 * 1024 * 1024;  // 2 MiB TCP通信接收缓存大小, 也是单个请求数据上限
 	static const int REPLY_BUF_SIZE = 8 * 1024 * 1024; // 8 MiB TCP通信回应缓存大小
-	unique_ptr<char[]> recvBuf, replyBuf;
+	static const int SMALL_REPLY_BUF_SIZE = 64 * 1024; // 64 KiB 回应较小的命令
+	static const int MAX_CONN = 32;           // 同时保持的连接上限, 超出则直接关闭新连接
+	static const int IDLE_TIMEOUT_SEC = 120;  // 保持连接 空闲超时
+	static const int STALL_TIMEOUT_SEC = 5;   // 请求未收全 或回应未发完 且无进展的超时
+	static const int READ_CHUNK = 64 * 1024;
+
+
+	struct connStruct {
+		uint64_t id = 0;
+		string inBuf;          // 已收到 未处理的请求数据
+		string outBuf;         // 未发完的回应数据
+		size_t outOffset = 0;
+		int busyCnt = 0;       // 在工作线程执行中的命令数, v1连接有则暂停处理后续请求, 保证回应顺序
+		uint8_t protoVersion = 0; // 按首个请求识别, 0:未知 1:v1 2:v2
+		bool isEof = false;    // 对端已关闭写端, 处理完剩余请求后关闭
+		bool isBroken = false; // 发送失败或请求非法, 需关闭
+		uint64_t lastActive = 0;
+
+		uint32_t subIntervalMs = 0; // 实时信息订阅 推送间隔, 0:未订阅
+		uint32_t subType = 0;       // realTimeType
+		uint32_t subHeight = 0, subWidth = 0;
+		uint64_t subNextNs = 0;     // 下次推送时间
+		uint32_t subRequestId = 0;  // v2 推送帧沿用订阅请求的ID
+	};
+
+	// 协议 v1: 请求头部6字节 [4字节数据长度 1字节命令 1字节数据异或校验], 回应头部6字节 [4字节数据长度 2字节保留]
+	// 协议 v2: 请求与回应使用相同的帧头部 frameHeaderV2, 回应原样带回 requestId 与 command,
+	//         同一连接可连续发送多个请求, 耗时命令的回应可能晚于之后的请求, 由 requestId 对应
+	// v1 数据长度小于 RECV_BUF_SIZE, 第4字节必为0, 而 v2 魔数第4字节非0, 据此按连接识别版本
+	constexpr static uint32_t FRAME_MAGIC = 0x54495A46; // "FZIT"
+	constexpr static uint8_t FRAME_VERSION = 2;
+	constexpr static uint8_t FRAME_FLAG_PUSH = 1;       // 订阅推送帧
+	constexpr static uint8_t FRAME_FLAG_ASYNC = 2;      // 请求: 修改类命令异步执行, 立即回应任务ID, 完成后推送结果
+	constexpr static int MAX_INFLIGHT = 8;              // v2连接 在工作线程排队执行的命令上限
+
+	struct frameHeaderV2 {
+		uint32_t magic;
+		uint8_t version;
+		uint8_t flags;
+		uint16_t command;
+		uint32_t requestId;
+		uint32_t length;  // 数据长度
+		uint32_t crc;     // 数据 CRC32C
+	};
+	static_assert(sizeof(frameHeaderV2) == 20);
+
+	// 接收缓存上限: 可容纳一个最大的完整请求, 帧头部按较长的 v2 计 (v1 为6字节)
+	constexpr static size_t IN_BUF_MAX = sizeof(frameHeaderV2) + RECV_BUF_SIZE;
+
+	// 回应需要的请求信息
+	struct replyTag {
+		uint8_t protoVersion = 1;
+		uint8_t flags = 0;
+		uint16_t command = 0;
+		uint32_t requestId = 0;
+	};
+	map<int, connStruct> connMap; // fd -> 连接
+	uint64_t connIdCnt = 0;
+	int epollFd = -1;
+
+	// 本地Socket 供管理器使用, 与TCP共用事件循环与协议
+	constexpr static char UNIX_SOCKET_NAME[] = "\0FreezeitServer";
+	constexpr static char MANAGER_DATA_PATH[] = "/data/data/io.github.jark006.freezeit";
+	int unixSock = -1;
+	int managerAppId = -1;
+
+	// 耗时命令交由工作线程执行, 执行结果(已含回应头部)经 doneEventFd 通知通信线程发出
+	struct jobStruct {
+		int fd = -1;
+		uint64_t connId = 0;
+		replyTag tag;
+		string data;  // 请求数据, 执行后替换为回应数据
+		uint32_t asyncId = 0; // 异步任务ID, 0:同步执行 连接等待其回应
+	};
+	mutex jobMutex;
+	std::condition_variable jobCV;
+	deque<jobStruct> jobQueue, doneQueue;
+	int doneEventFd = -1;
+
+	// 异步任务: v2请求带 FRAME_FLAG_ASYNC 的修改类命令, 立即回应任务ID, 进度与结果可由 getJobState 查询
+	// 完成后向发起连接推送结果帧(若连接仍在), 帧头部 flags 为 PUSH|ASYNC, 沿用原请求的 command 与 requestId
+	enum JOB_STATE : uint32_t {
+		JOB_UNKNOWN = 0, // 不存在或已过期
+		JOB_QUEUED = 1,
+		JOB_RUNNING = 2,
+		JOB_DONE = 3,
+	};
+	struct asyncJobRecord {
+		JOB_STATE state = JOB_QUEUED;
+		uint16_t command = 0;
+		uint64_t submitNs = 0, doneNs = 0;
+		string text; // 执行中为当前阶段, 完成后为回应数据
+	};
+	constexpr static size_t ASYNC_PENDING_MAX = 16; // 未完成的异步任务上限
+	constexpr static size_t ASYNC_DONE_KEEP = 32;   // 保留的已完成任务记录数
+	map<uint32_t, asyncJobRecord> asyncJobMap;      // jobMutex 保护
+	uint32_t asyncIdCnt = 0;
+	uint32_t runningAsyncId = 0; // 工作线程当前执行的异步任务
+
+	// 耗时的只读命令短时间内重复请求时直接返回缓存, 修改配置/设置/日志的命令使缓存全部失效
+	ReplyCache replyCache;
+
+	static uint32_t getCacheTtlMs(const int appCommand) {
+		switch (appCommand) {
+		case cmdEnum::getProcState:
+			return 3000;
+		case cmdEnum::getUidTime:
+			return 2000;
+		case cmdEnum::getRealTimeInfo:
+			return 500;
+		default:
+			return 0;
+		}
+	}
+
+	// 回应长度的下限, 用于事先判断能否缓存; 无法预知的为0
+	static size_t minReplyLen(const int appCommand, const char* req, const int recvLen) {
+		if (appCommand != cmdEnum::getRealTimeInfo || (recvLen != 12 && recvLen != 16))
+			return 0;
+
+		uint32_t param[4]{ 0, 0, 0, REALTIME_CHART };
+		memcpy(param, req, recvLen);
+		return param[3] == REALTIME_CHART ? SystemTools::chartImgSize(param[0], param[1]) : 0;
+	}
+
+	// 通信线程直接执行的命令按需取回应缓存, 回应可能较大的才取 REPLY_BUF_SIZE
+	static size_t replyBufSize(const int appCommand, const char* req, const int recvLen) {
+		switch (appCommand) {
+		case cmdEnum::getRealTimeInfo:
+			return minReplyLen(appCommand, req, recvLen) + SMALL_REPLY_BUF_SIZE;
+		case cmdEnum::getEvents:
+		case cmdEnum::getTraceStat:
+		case cmdEnum::getMetrics:
+		case cmdEnum::getMetricsText:
+		case cmdEnum::getTraceJson:
+		case cmdEnum::getJobState:
+			return REPLY_BUF_SIZE;
+		default:
+			return SMALL_REPLY_BUF_SIZE;
+		}
+	}
+
+	static bool isInvalidateCacheCmd(const int appCommand) {
+		switch (appCommand) {
+		case cmdEnum::setAppCfg:
+		case cmdEnum::setAppLabel:
+		case cmdEnum::setSettingsVar:
+		case cmdEnum::clearLog:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// 收集回应到 out, 用固定类型而非lambda, 理由同 batchItemReply
+	struct replyCollector {
+		string& out;
+
+		void operator()(const iovec* seg, const int segCnt) const { appendIov(out, seg, segCnt, 0); }
+	};
+
+	// 实时信息订阅: 无订阅者时定时器停止, 不再采样
+	constexpr static uint32_t SUB_INTERVAL_MIN_MS = 200;
+	constexpr static uint32_t SUB_INTERVAL_MAX_MS = 10000;
+	int subTimerFd = -1;
+	uint32_t subTimerMs = 0; // 当前定时器周期, 0:已停止
+
+	enum realTimeType : uint32_t {
+		REALTIME_CHART = 0, // 图表 + 数据, 同 getRealTimeInfo
+		REALTIME_STATS = 1, // 仅数据 92字节
+		REALTIME_SERIES = 2, // 采样序列 + 数据, 由客户端绘图 见 SystemTools::formatRealTimeSeries()
+	};
 
 	enum cmdEnum {
 		// 获取信息 无附加数据 No additional data required
@@ -29,8 +201,15 @@ private:
 		getLog = 4,          // return string: "log"
 		getAppCfg = 5,       // return string: "package x\npackage x\n...
 		getRealTimeInfo = 6, // return ImgBytes[h*w*4]+String: (rawBitmap + 内存 频率 使用率 电流)
+		                     // send uint32[3]: [height, width, availableMiB], 可附加第4项 realTimeType
 		getSettings = 8,     // return bytes[256]: all settings parameter
 		getUidTime = 9,      // return "uid last_user_time last_sys_time user_time sys_time\n..."
+		getLogSince = 10,    // send uint64[2]: cursor [epoch, seq], return uint64[4]: [epoch, startSeq, endSeq, isReset] + "log"
+		                     // 仅返回cursor之后的日志, [epoch, endSeq]即新cursor; 纪元不符(进程已重启 首次请求)或日志已被覆盖/清理时
+		                     // isReset 为1, 返回全部日志, 客户端需先清空已有内容
+		getEvents = 11,      // send int32[2]: [uid(-1:全部), typeMask(bit[EVENT])], return uint32: count + eventRecord[count]
+		subscribeRealTime = 12, // send uint32[4]: [intervalMs(0:取消订阅), realTimeType, height, width]
+		                        // 订阅后立即回应首帧, 之后按间隔推送, 推送帧头部保留字节[0]为12; 取消订阅回应 "success"
 
 		// 设置 需附加数据
 		setAppCfg = 21,      // send "package x\npackage x\npackage x\n..."
@@ -40,9 +219,62 @@ private:
 		// 其他命令 无附加数据 No additional data required
 		clearLog = 61,       // return string: "log" //清理并返回log
 		getProcState = 62, // return string: "log" //打印冻结状态并返回log
+		getTraceStat = 63, // return string: 函数耗时统计 //可附加1字节, 非0则返回后清零统计
+		getMetrics = 64,   // return bytes: 运行指标 二进制格式见 metrics.hpp
+		getMetricsText = 65, // return string: 运行指标 Prometheus 文本格式
+		getTraceJson = 66, // return string: 片段记录 Chrome trace-event JSON, 需开启耗时统计
+		getSelfCost = 67,  // return string: 各线程/模块 CPU时间 调度与唤醒次数
+		getMemStats = 68,  // return string: 进程RSS 与缓冲池/各模块缓冲区占用
+
+		// 批量命令 一次往返取得多项信息, 子命令仅限获取信息类, 按顺序执行
+		getBatch = 80,     // send [batchItem + data]..., return [batchItem + reply]... //batchItem.length 为其后数据长度
+		getJobState = 81,  // send uint32: jobId, return uint32[2]: [JOB_STATE, 已耗时ms] + string: 执行阶段或回应数据
+	};
 
+	struct batchItem {
+		uint32_t command;
+		uint32_t length;
 	};
 
+	static bool isBatchableCmd(const int appCommand) {
+		switch (appCommand) {
+		case cmdEnum::getPropInfo:
+		case cmdEnum::getChangelog:
+		case cmdEnum::getLog:
+		case cmdEnum::getAppCfg:
+		case cmdEnum::getSettings:
+		case cmdEnum::getUidTime:
+		case cmdEnum::getLogSince:
+		case cmdEnum::getEvents:
+		case cmdEnum::getMetrics:
+		case cmdEnum::getMetricsText:
+		case cmdEnum::getSelfCost:
+		case cmdEnum::getMemStats:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// 访问应用配置或执行较慢(杀进程 dumpsys 等)的命令, 交由工作线程串行执行, 其余命令在通信线程直接回应
+	static bool isHeavyCmd(const int appCommand) {
+		switch (appCommand) {
+		case cmdEnum::getAppCfg:
+		case cmdEnum::getUidTime:
+		case cmdEnum::setAppCfg:
+		case cmdEnum::setAppLabel:
+		case cmdEnum::getProcState:
+		case cmdEnum::getBatch: // 在工作线程执行, 与修改配置的命令串行, 整批看到同一份应用配置
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	static bool isAsyncableCmd(const int appCommand) {
+		return appCommand == cmdEnum::setAppCfg || appCommand == cmdEnum::setAppLabel;
+	}
+
 public:
 	Server& operator=(Server&&) = delete;
 
@@ -50,31 +282,21 @@ public:
 		Doze& doze, Freezer& freezer) :
 		freezeit(freezeit), settings(settings), managedApp(managedApp),
 		systemTools(systemTools), freezer(freezer), doze(doze) {
+		doneEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		subTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (doneEventFd < 0 || subTimerFd < 0) {
+			fprintf(stderr, "eventfd()/timerfd_create() 失败 [%d]:[%s]", errno, strerror(errno));
+			exit(-1);
+		}
+		workerThread = thread(&Server::workerThreadFunc, this);
 		serverThread = thread(&Server::serverThreadFunc, this);
 	}
 
 	void serverThreadFunc() {
-		/*  LOCAL_SOCKET  *******************************************************************/
-		// Socket 位于Linux抽象命名空间， 而不是文件路径
-		// https://blog.csdn.net/howellzhu/article/details/111597734
-		// https://blog.csdn.net/shanzhizi/article/details/16882087 一种是路径方式 一种是抽象命名空间
-		//const int addrLen = offsetof(sockaddr_un, sun_path) + 15; // addrLen大小是 首个占位符 '\0' 加 "FreezeitServer" 的字符长度
-		//const sockaddr_un serv_addr{ AF_UNIX, "\0FreezeitServer" }; // 首位为空[0]=0，位于Linux抽象命名空间
-		//sockaddr_un clnt_addr{};
-		//socklen_t clnt_addr_size = sizeof(sockaddr_un);
-		// 
-		// 终端执行 setenforce 0 ，即设置 SELinux 为宽容模式, 普通安卓应用才可以使用 LocalSocket
-		//system("setenforce 0");
-		/*  LOCAL_SOCKET  *******************************************************************/
+		Trace::setThreadName("server");
 
 		constexpr socklen_t addrLen = sizeof(sockaddr);
 		const sockaddr_in serv_addr{ AF_INET, htons(60613), {inet_addr("127.0.0.1")}, {} };
-		sockaddr_in clnt_addr{};
-		socklen_t clnt_addr_size = sizeof(sockaddr_in);
-
-
-		recvBuf = make_unique<char[]>(RECV_BUF_SIZE);
-		replyBuf = make_unique<char[]>(REPLY_BUF_SIZE);
 
 		while (true) {
 			static int failTcpCnt = 0;
@@ -90,16 +312,9 @@ public:
 
 			int serv_sock;
 
-			/*  LOCAL_SOCKET  *******************************************************************/
-			//if ((serv_sock = socket(AF_UNIX, SOCK_STREAM, 0)) <= 0) {
-			//	fprintf(stderr, "socket() Fail serv_sock[%d], [%d]:[%s]", serv_sock, errno, strerror(errno));
-			//	continue;
-			//}
-			/*  LOCAL_SOCKET  *******************************************************************/
-
-
 			/*  NORMAL_SOCKET  ******************************************************************/
-			if ((serv_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) <= 0) {
+			if ((serv_sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+				IPPROTO_TCP)) <= 0) {
 				fprintf(stderr, "socket() Fail serv_sock[%d], [%d]:[%s]", serv_sock, errno,
 					strerror(errno));
 				continue;
@@ -109,6 +324,7 @@ public:
 			if (setsockopt(serv_sock, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt))) {
 				fprintf(stderr, "setsockopt() Fail serv_sock[%d], [%d]:[%s]", serv_sock, errno,
 					strerror(errno));
+				close(serv_sock);
 				continue;
 			}
 			/*  NORMAL_SOCKET  ******************************************************************/
@@ -117,97 +333,673 @@ public:
 
 			if (bind(serv_sock, (sockaddr*)&serv_addr, addrLen) < 0) {
 				fprintf(stderr, "bind() Fail, [%d]:[%s]", errno, strerror(errno));
+				close(serv_sock);
 				continue;
 			}
 
 			if (listen(serv_sock, 64) < 0) {
 				fprintf(stderr, "listen() Fail, [%d]:[%s]", errno, strerror(errno));
+				close(serv_sock);
 				continue;
 			}
 
-			while (true) {
-				int clnt_sock = accept(serv_sock, (sockaddr*)&clnt_addr, &clnt_addr_size);
-				if (clnt_sock < 0) {
-					static int failCnt = 1;
+			epollFd = epoll_create1(EPOLL_CLOEXEC);
+			if (epollFd < 0) {
+				fprintf(stderr, "epoll_create1() Fail, [%d]:[%s]", errno, strerror(errno));
+				close(serv_sock);
+				continue;
+			}
 
-					fprintf(stderr, "accept() 第%d次错误 servFd[%d] clntFd[%d] size[%d]; [%d]:[%s]",
-						failCnt, serv_sock, clnt_sock, clnt_addr_size, errno, strerror(errno));
+			epoll_event ev{ EPOLLIN, {} };
+			ev.data.fd = serv_sock;
+			epoll_ctl(epollFd, EPOLL_CTL_ADD, serv_sock, &ev);
+			ev.data.fd = doneEventFd;
+			epoll_ctl(epollFd, EPOLL_CTL_ADD, doneEventFd, &ev);
+			ev.data.fd = subTimerFd;
+			epoll_ctl(epollFd, EPOLL_CTL_ADD, subTimerFd, &ev);
+
+			unixSock = createUnixListener();
+			if (unixSock >= 0) {
+				ev.data.fd = unixSock;
+				epoll_ctl(epollFd, EPOLL_CTL_ADD, unixSock, &ev);
+			}
 
-					if (++failCnt > 10) break;
+			eventLoop(serv_sock);
 
-					sleep(2);
-					continue;
-				}
+			while (!connMap.empty())
+				closeConn(connMap.begin()->first);
+			close(epollFd);
+			epollFd = -1;
+			if (unixSock >= 0) {
+				close(unixSock);
+				unixSock = -1;
+			}
+			close(serv_sock);
+		}
+	}
 
-				//设置接收超时
-				timeval timeout = { 1, 0 }; // 1秒 超时
-				if (setsockopt(clnt_sock, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout,
-					sizeof(timeval))) {
-					fprintf(stderr, "setsockopt 超时设置出错 servFd[%d] clntFd[%d] [%d]:[%s]", serv_sock,
-						clnt_sock, errno, strerror(errno));
-					close(clnt_sock);
-					continue;
-				}
+	// 非阻塞事件循环, 仅在监听出错时返回
+	void eventLoop(const int serv_sock) {
+		epoll_event events[32];
+		int acceptFailCnt = 0;
+		uint64_t lastSweep = 0;
+		while (true) {
+			const int nfds = epoll_wait(epollFd, events, 32, 1000);
+			if (nfds < 0) {
+				if (errno == EINTR) continue;
+				fprintf(stderr, "epoll_wait() Fail, [%d]:[%s]", errno, strerror(errno));
+				return;
+			}
 
-				uint8_t dataHeader[6];
-				uint32_t recvLen = recv(clnt_sock, dataHeader, sizeof(dataHeader), MSG_WAITALL);
-				if (recvLen != sizeof(dataHeader)) {
-					close(clnt_sock);
-					fprintf(stderr, "clnt_sock recv dataHeader len[%u]", recvLen);
-					continue;
+			for (int i = 0; i < nfds; i++) {
+				const int fd = events[i].data.fd;
+				if (fd == serv_sock || fd == unixSock) {
+					if (!acceptConn(fd) && ++acceptFailCnt > 10)
+						return;
 				}
+				else if (fd == doneEventFd)
+					handleDone();
+				else if (fd == subTimerFd)
+					handleSubTimer();
+				else
+					handleConn(fd, events[i].events);
+			}
 
-				recvLen = *((uint32_t*)dataHeader);
-				uint32_t appCommand = dataHeader[4];
-				uint32_t XOR_value = dataHeader[5];
+			const uint64_t now = nowSec();
+			if (now != lastSweep) {
+				lastSweep = now;
+				closeTimeoutConn(now);
+			}
+		}
+	}
+
+	// 本地Socket 位于Linux抽象命名空间, 而不是文件路径, 无需处理文件权限与残留
+	// https://blog.csdn.net/shanzhizi/article/details/16882087 一种是路径方式 一种是抽象命名空间
+	// 失败不影响TCP通信
+	static int createUnixListener() {
+		const int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (sock < 0) {
+			fprintf(stderr, "socket(AF_UNIX) Fail, [%d]:[%s]", errno, strerror(errno));
+			return -1;
+		}
+
+		sockaddr_un addr{};
+		addr.sun_family = AF_UNIX;
+		memcpy(addr.sun_path, UNIX_SOCKET_NAME, sizeof(UNIX_SOCKET_NAME) - 1); // 首位为空[0]=0
+		const socklen_t addrLen = offsetof(sockaddr_un, sun_path) + sizeof(UNIX_SOCKET_NAME) - 1;
 
-				// "\0AUTH\n" B站发的，前4字节： 大端 4281684, 小端 1414873344
-				if (recvLen == 1414873344 || recvLen == 4281684) {
-					close(clnt_sock);
-					continue;
+		if (bind(sock, (sockaddr*)&addr, addrLen) < 0 || listen(sock, 64) < 0) {
+			fprintf(stderr, "bind()/listen() AF_UNIX Fail, [%d]:[%s]", errno, strerror(errno));
+			close(sock);
+			return -1;
+		}
+		return sock;
+	}
+
+	// 本地Socket 仅接受 root 或冻它管理器(各用户空间下同一应用)的连接, 在读取任何数据之前检查
+	bool isTrustedPeer(const int fd) {
+		ucred cred{};
+		socklen_t len = sizeof(cred);
+		if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len)) {
+			fprintf(stderr, "SO_PEERCRED Fail, [%d]:[%s]", errno, strerror(errno));
+			return false;
+		}
+		if (cred.uid == 0) return true;
+
+		const int appId = static_cast<int>(cred.uid % 100000);
+		if (appId == managerAppId) return true;
+
+		struct stat statBuf {}; // 管理器可能已重装, UID 会变化
+		if (!stat(MANAGER_DATA_PATH, &statBuf))
+			managerAppId = static_cast<int>(statBuf.st_uid % 100000);
+		if (appId == managerAppId) return true;
+
+		LOG_LIMIT(60, "拒绝本地连接 UID:%u PID:%d", cred.uid, cred.pid);
+		return false;
+	}
+
+	static uint64_t nowSec() {
+		return Trace::nowNs() / 1000000000;
+	}
+
+	bool acceptConn(const int serv_sock) {
+		while (true) {
+			const int fd = accept4(serv_sock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNABORTED)
+					return true;
+				fprintf(stderr, "accept() 错误 servFd[%d] [%d]:[%s]", serv_sock, errno, strerror(errno));
+				return false;
+			}
+
+			if (serv_sock == unixSock && !isTrustedPeer(fd)) {
+				close(fd);
+				continue;
+			}
+
+			if (connMap.size() >= MAX_CONN) {
+				LOG_LIMIT(60, "连接数已达上限 %d, 拒绝新连接", MAX_CONN);
+				close(fd);
+				continue;
+			}
+
+			auto& conn = connMap[fd];
+			conn.id = ++connIdCnt;
+			conn.lastActive = nowSec();
+
+			epoll_event ev{ EPOLLIN | EPOLLRDHUP, {} };
+			ev.data.fd = fd;
+			epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+		}
+	}
+
+	void closeConn(const int fd) {
+		epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+		close(fd);
+		auto it = connMap.find(fd);
+		if (it == connMap.end()) return;
+		const bool isSubscribed = it->second.subIntervalMs;
+		connMap.erase(it);
+		if (isSubscribed)
+			updateSubTimer();
+	}
+
+	// 空闲过久 或请求/回应停滞的连接, 工作线程执行中的除外
+	void closeTimeoutConn(const uint64_t now) {
+		vector<int> timeoutFds;
+		for (const auto& [fd, conn] : connMap) {
+			if (conn.busyCnt) continue;
+			const bool isIdle = conn.inBuf.empty() && conn.outBuf.empty();
+			if (now - conn.lastActive > static_cast<uint64_t>(isIdle ? IDLE_TIMEOUT_SEC : STALL_TIMEOUT_SEC))
+				timeoutFds.emplace_back(fd);
+		}
+		for (const int fd : timeoutFds)
+			closeConn(fd);
+	}
+
+	void handleConn(const int fd, const uint32_t events) {
+		auto it = connMap.find(fd);
+		if (it == connMap.end()) return;
+		auto& conn = it->second;
+
+		if (events & (EPOLLERR | EPOLLHUP)) { // 对端已完全关闭, 工作线程的结果将被丢弃
+			closeConn(fd);
+			return;
+		}
+		if (events & EPOLLOUT)
+			flushOut(fd, conn);
+		if (events & (EPOLLIN | EPOLLRDHUP))
+			readIn(fd, conn);
+
+		processConn(fd, conn);
+		updateConn(fd, conn);
+	}
+
+	void readIn(const int fd, connStruct& conn) {
+		while (!conn.isEof && conn.inBuf.length() < IN_BUF_MAX) {
+			const size_t oldLen = conn.inBuf.length();
+			conn.inBuf.resize(oldLen + READ_CHUNK);
+			const ssize_t len = recv(fd, conn.inBuf.data() + oldLen, READ_CHUNK, 0);
+			conn.inBuf.resize(oldLen + (len > 0 ? len : 0));
+
+			if (len > 0) {
+				conn.lastActive = nowSec();
+				if (len < READ_CHUNK) break;
+			}
+			else if (len == 0)
+				conn.isEof = true;
+			else {
+				if (errno == EINTR) continue;
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+					conn.isBroken = true;
+				break;
+			}
+		}
+	}
+
+	// 解析并执行已收全的请求, 回应未发完时暂停
+	// v1连接的请求按顺序执行, 有命令在工作线程执行中时暂停; v2连接可继续处理之后的请求
+	void processConn(const int fd, connStruct& conn) {
+		while (!conn.isBroken && conn.outBuf.empty() && conn.inBuf.length() >= 6) {
+			if (conn.protoVersion == 0) {
+				uint32_t magic;
+				memcpy(&magic, conn.inBuf.data(), 4);
+				conn.protoVersion = magic == FRAME_MAGIC ? 2 : 1;
+			}
+			if (conn.protoVersion == 1 ? (conn.busyCnt > 0) : (conn.busyCnt >= MAX_INFLIGHT))
+				return;
+
+			replyTag tag;
+			uint32_t headerLen, recvLen;
+			const int res = conn.protoVersion == 1 ? parseFrameV1(conn.inBuf, tag, headerLen, recvLen) :
+				parseFrameV2(conn.inBuf, tag, headerLen, recvLen);
+			if (res <= 0) { // 0:未收全 -1:格式或校验错误
+				if (res < 0) conn.isBroken = true;
+				return;
+			}
+
+			const char* data = conn.inBuf.data() + headerLen;
+			if (tag.command == cmdEnum::subscribeRealTime) {
+				handleSubscribe(fd, conn, tag, data, recvLen);
+			}
+			else if ((tag.flags & FRAME_FLAG_ASYNC) && isAsyncableCmd(tag.command)) {
+				submitAsyncJob(fd, conn, tag, data, recvLen);
+			}
+			else if (isHeavyCmd(tag.command)) {
+				conn.busyCnt++;
+				{
+					lock_guard<mutex> lock(jobMutex);
+					jobQueue.emplace_back(jobStruct{ fd, conn.id, tag, string(data, recvLen) });
 				}
-				else if (recvLen >= RECV_BUF_SIZE) {
-					freezeit.log("数据格式异常 recvLen[%u] HEX[%s]", recvLen,
-						Utils::bin2Hex(dataHeader, 6).c_str());
-					close(clnt_sock);
-					continue;
+				jobCV.notify_one();
+			}
+			else {
+				const size_t replyCap = replyBufSize(tag.command, data, recvLen);
+				auto reqBuf = BufferPool::acquire(recvLen + 1, BufferPool::OWNER_SERVER);
+				auto replyBuf = BufferPool::acquire(replyCap, BufferPool::OWNER_SERVER);
+				if (!reqBuf || !replyBuf) {
+					conn.isBroken = true;
+					return;
 				}
+				memcpy(reqBuf.data(), data, recvLen);
+				reqBuf.data()[recvLen] = 0;
+				handleCmd(tag.command, recvLen, reqBuf.data(), replyBuf.data(), replyCap,
+					[&](const iovec* seg, const int segCnt) { sendReply(fd, conn, tag, seg, segCnt); });
+			}
+			conn.inBuf.erase(0, headerLen + recvLen);
+			if (conn.inBuf.empty() && conn.inBuf.capacity() > 2 * READ_CHUNK)
+				conn.inBuf.shrink_to_fit(); // 大请求之后释放接收缓存
+		}
+	}
+
+	// 返回 1:完整请求 0:未收全 -1:格式或校验错误
+	int parseFrameV1(const string& inBuf, replyTag& tag, uint32_t& headerLen, uint32_t& recvLen) {
+		const uint8_t* dataHeader = reinterpret_cast<const uint8_t*>(inBuf.data());
+		memcpy(&recvLen, dataHeader, 4);
+		const uint32_t XOR_value = dataHeader[5];
+		headerLen = 6;
+		tag = replyTag{ 1, 0, dataHeader[4], 0 };
+
+		// "\0AUTH\n" B站发的，前4字节： 大端 4281684, 小端 1414873344
+		if (recvLen == 1414873344 || recvLen == 4281684)
+			return -1;
+		else if (recvLen >= RECV_BUF_SIZE) {
+			freezeit.log("数据格式异常 recvLen[%u] HEX[%s]", recvLen,
+				Utils::bin2Hex(dataHeader, 6).c_str());
+			return -1;
+		}
+
+		if (inBuf.length() < headerLen + recvLen) return 0; // 附带数据未收全
+
+		uint8_t XOR_cal = 0;
+		for (uint32_t i = 0; i < recvLen; i++)
+			XOR_cal ^= dataHeader[headerLen + i];
 
-				if (recvLen) {
-					uint32_t lenTmp = recv(clnt_sock, recvBuf.get(), recvLen, MSG_WAITALL);
-					if (lenTmp != recvLen) {
-						fprintf(stderr, "附带数据接收错误, appCommand[%u], 要求[%u], 实际接收[%u]", appCommand,
-							recvLen, lenTmp);
-						close(clnt_sock);
-						continue;
-					}
-
-					uint8_t XOR_cal = 0;
-					for (uint32_t i = 0; i < recvLen; i++)
-						XOR_cal ^= (uint8_t)recvBuf[i];
-
-					if (XOR_value != XOR_cal) {
-						fprintf(stderr, "%s() 数据校验错误, 提供值[0x%2x], 接收数据计算值[0x%2x]", __FUNCTION__,
-							XOR_value, XOR_cal);
-						close(clnt_sock);
-						continue;
-					}
+		if (XOR_value != XOR_cal) {
+			fprintf(stderr, "%s() 数据校验错误, 提供值[0x%2x], 接收数据计算值[0x%2x]", __FUNCTION__,
+				XOR_value, XOR_cal);
+			return -1;
+		}
+		return 1;
+	}
+
+	int parseFrameV2(const string& inBuf, replyTag& tag, uint32_t& headerLen, uint32_t& recvLen) {
+		headerLen = sizeof(frameHeaderV2);
+		if (inBuf.length() < headerLen) return 0;
+
+		frameHeaderV2 header;
+		memcpy(&header, inBuf.data(), sizeof(header));
+		recvLen = header.length;
+		tag = replyTag{ 2, static_cast<uint8_t>(header.flags & FRAME_FLAG_ASYNC), header.command,
+			header.requestId };
+
+		if (header.magic != FRAME_MAGIC || header.version != FRAME_VERSION || recvLen >= RECV_BUF_SIZE) {
+			freezeit.log("v2数据格式异常 HEX[%s]",
+				Utils::bin2Hex(inBuf.data(), sizeof(header)).c_str());
+			return -1;
+		}
+
+		if (inBuf.length() < headerLen + recvLen) return 0;
+
+		const uint32_t crc = Utils::crc32c(inBuf.data() + headerLen, recvLen);
+		if (crc != header.crc) {
+			fprintf(stderr, "%s() 数据校验错误 requestId[%u], 提供值[0x%08x], 计算值[0x%08x]", __FUNCTION__,
+				header.requestId, header.crc, crc);
+			return -1;
+		}
+		return 1;
+	}
+
+	// 按连接状态更新关注的事件: 回应未发完时关注可写, 可处理新请求时关注可读
+	void updateConn(const int fd, connStruct& conn) {
+		const bool isDone = conn.busyCnt == 0 && conn.outBuf.empty();
+		if (conn.isBroken || (conn.isEof && isDone)) {
+			closeConn(fd);
+			return;
+		}
+
+		// v1 等待回应发完再读下一个请求; v2 在途命令未满时继续接收, 接收缓存满则暂停(水平触发)
+		const bool isReadable = conn.protoVersion == 2 ?
+			(conn.busyCnt < MAX_INFLIGHT && conn.inBuf.length() < IN_BUF_MAX) : isDone;
+
+		epoll_event ev{ 0, {} };
+		ev.data.fd = fd;
+		if (!conn.outBuf.empty())
+			ev.events |= EPOLLOUT;
+		if (isReadable && !conn.isEof)
+			ev.events |= EPOLLIN | EPOLLRDHUP;
+		epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+	}
+
+	void handleDone() {
+		uint64_t cnt;
+		if (read(doneEventFd, &cnt, sizeof(cnt)) != sizeof(cnt)) return;
+
+		deque<jobStruct> doneJobs;
+		{
+			lock_guard<mutex> lock(jobMutex);
+			doneJobs.swap(doneQueue);
+		}
+
+		for (auto& job : doneJobs) {
+			auto it = connMap.find(job.fd);
+			if (it == connMap.end() || it->second.id != job.connId) continue; // 连接已关闭
+
+			auto& conn = it->second;
+			if (job.asyncId == 0) conn.busyCnt--;
+			conn.lastActive = nowSec();
+			const iovec seg{ job.data.data(), job.data.length() };
+			sendBytes(job.fd, conn, &seg, 1);
+
+			processConn(job.fd, conn);
+			updateConn(job.fd, conn);
+		}
+	}
+
+	void submitAsyncJob(const int fd, connStruct& conn, const replyTag& tag, const char* data,
+		const uint32_t recvLen) {
+		uint32_t asyncId = 0;
+		{
+			lock_guard<mutex> lock(jobMutex);
+			size_t pendingCnt = 0;
+			for (const auto& [id, record] : asyncJobMap)
+				if (record.state != JOB_DONE) pendingCnt++;
+
+			if (pendingCnt < ASYNC_PENDING_MAX) {
+				asyncId = ++asyncIdCnt;
+				if (asyncId == 0) asyncId = ++asyncIdCnt;
+				asyncJobMap[asyncId] = asyncJobRecord{ JOB_QUEUED, tag.command, Trace::nowNs(), 0, {} };
+				jobQueue.emplace_back(jobStruct{ fd, conn.id, tag, string(data, recvLen), asyncId });
+			}
+		}
+
+		if (asyncId == 0) {
+			static const char tips[] = "异步任务过多, 请稍后再试";
+			const iovec seg{ const_cast<char*>(tips), sizeof(tips) - 1 };
+			sendReply(fd, conn, tag, &seg, 1);
+			return;
+		}
+		jobCV.notify_one();
+
+		const iovec seg{ &asyncId, sizeof(asyncId) };
+		sendReply(fd, conn, tag, &seg, 1);
+	}
+
+	// 工作线程执行异步任务时更新当前阶段, 同步执行时无操作
+	void setJobStage(const char* fmt, ...) {
+		if (runningAsyncId == 0) return;
+
+		char stage[256];
+		va_list args;
+		va_start(args, fmt);
+		vsnprintf(stage, sizeof(stage), fmt, args);
+		va_end(args);
+
+		lock_guard<mutex> lock(jobMutex);
+		auto it = asyncJobMap.find(runningAsyncId);
+		if (it != asyncJobMap.end()) it->second.text = stage;
+	}
+
+	// 记录完成状态, 超出保留数量时删除最早的已完成记录, 需持有 jobMutex
+	void finishAsyncJob(const uint32_t asyncId, string&& result) {
+		auto it = asyncJobMap.find(asyncId);
+		if (it == asyncJobMap.end()) return;
+		it->second.state = JOB_DONE;
+		it->second.doneNs = Trace::nowNs();
+		it->second.text = move(result);
+
+		size_t doneCnt = 0;
+		for (const auto& [id, record] : asyncJobMap)
+			if (record.state == JOB_DONE) doneCnt++;
+		for (auto iter = asyncJobMap.begin(); doneCnt > ASYNC_DONE_KEEP && iter != asyncJobMap.end();) {
+			if (iter->second.state == JOB_DONE) {
+				iter = asyncJobMap.erase(iter);
+				doneCnt--;
+			}
+			else iter++;
+		}
+	}
+
+	uint32_t formatJobState(const uint32_t asyncId, char* reply, const size_t replyCap) {
+		lock_guard<mutex> lock(jobMutex);
+		uint32_t head[2] = { JOB_UNKNOWN, 0 };
+		auto it = asyncJobMap.find(asyncId);
+		if (it == asyncJobMap.end()) {
+			memcpy(reply, head, sizeof(head));
+			return sizeof(head);
+		}
+
+		const auto& record = it->second;
+		head[0] = record.state;
+		head[1] = ((record.state == JOB_DONE ? record.doneNs : Trace::nowNs()) - record.submitNs) / 1'000'000;
+		memcpy(reply, head, sizeof(head));
+		const size_t textLen = std::min(record.text.length(), replyCap - sizeof(head));
+		memcpy(reply + sizeof(head), record.text.data(), textLen);
+		return sizeof(head) + textLen;
+	}
+
+	void handleSubscribe(const int fd, connStruct& conn, const replyTag& tag, const char* data,
+		const uint32_t recvLen) {
+		TRACE_SCOPE;
+		char tips[128];
+		uint32_t param[4];
+		if (recvLen != sizeof(param)) {
+			const int len = snprintf(tips, sizeof(tips), "订阅需要16字节, 实际收到[%u]", recvLen);
+			const iovec seg{ tips, static_cast<size_t>(len) };
+			sendReply(fd, conn, tag, &seg, 1);
+			return;
+		}
+		memcpy(param, data, sizeof(param));
+
+		const auto [intervalMs, type, height, width] = param;
+		if (intervalMs == 0) {
+			conn.subIntervalMs = 0;
+			updateSubTimer();
+			const iovec seg{ const_cast<char*>("success"), 7 };
+			sendReply(fd, conn, tag, &seg, 1);
+			return;
+		}
+
+		if (type > REALTIME_SERIES || (type == REALTIME_CHART && (height < 20 || width < 20))) {
+			const int len = snprintf(tips, sizeof(tips), "订阅参数不符合, type[%u] height[%u] width[%u]",
+				type, height, width);
+			const iovec seg{ tips, static_cast<size_t>(len) };
+			sendReply(fd, conn, tag, &seg, 1);
+			return;
+		}
+
+		conn.subIntervalMs = std::clamp(intervalMs, SUB_INTERVAL_MIN_MS, SUB_INTERVAL_MAX_MS);
+		conn.subType = type;
+		conn.subHeight = height;
+		conn.subWidth = width;
+		conn.subNextNs = Trace::nowNs() + conn.subIntervalMs * 1000000ULL;
+		conn.subRequestId = tag.requestId;
+		updateSubTimer();
+
+		auto frameBuf = BufferPool::acquire(REPLY_BUF_SIZE, BufferPool::OWNER_SERVER);
+		if (!frameBuf) return;
+		systemTools.getCPU_realtime(SystemTools::readMemAvailableMiB());
+		const iovec seg{ frameBuf.data(), renderRealTime(frameBuf.data(), type, height, width) };
+		sendReply(fd, conn, tag, &seg, 1);
+	}
+
+	size_t renderRealTime(char* buf, const uint32_t type, const uint32_t height, const uint32_t width) {
+		switch (type) {
+		case REALTIME_CHART: {
+			const size_t len = systemTools.drawChart(reinterpret_cast<uint32_t*>(buf), height, width);
+			return len + systemTools.formatRealTime(reinterpret_cast<int*>(buf + len));
+		}
+		case REALTIME_SERIES:
+			return systemTools.formatRealTimeSeries(reinterpret_cast<int*>(buf));
+		default:
+			return systemTools.formatRealTime(reinterpret_cast<int*>(buf));
+		}
+	}
+
+	// 定时器周期取所有订阅的最短间隔, 无订阅则停止
+	void updateSubTimer() {
+		uint32_t minMs = 0;
+		for (const auto& [fd, conn] : connMap) {
+			if (conn.subIntervalMs && (minMs == 0 || conn.subIntervalMs < minMs))
+				minMs = conn.subIntervalMs;
+		}
+		if (minMs == subTimerMs) return;
+
+		subTimerMs = minMs;
+		const timespec period{ minMs / 1000, (minMs % 1000) * 1000000L };
+		const itimerspec spec{ period, period };
+		timerfd_settime(subTimerFd, 0, &spec, nullptr);
+	}
+
+	// 每个周期最多采样一次, 仅推送到期的订阅; 上一帧未发完的连接跳过本帧
+	void handleSubTimer() {
+		uint64_t expireCnt;
+		if (read(subTimerFd, &expireCnt, sizeof(expireCnt)) != sizeof(expireCnt)) return;
+		TRACE_SCOPE;
+
+		const uint64_t now = Trace::nowNs() + 1000000; // 1ms 容差
+		bool isSampled = false;
+		BufferPool::buffer frameBuf;
+		vector<int> pushedFds;
+		for (auto& [fd, conn] : connMap) {
+			if (conn.subIntervalMs == 0 || conn.subNextNs > now) continue;
+
+			conn.subNextNs += conn.subIntervalMs * 1000000ULL;
+			if (conn.subNextNs <= now)
+				conn.subNextNs = now + conn.subIntervalMs * 1000000ULL;
+			if (!conn.outBuf.empty()) continue;
+
+			if (!isSampled) {
+				isSampled = true;
+				frameBuf = BufferPool::acquire(REPLY_BUF_SIZE, BufferPool::OWNER_SERVER);
+				systemTools.getCPU_realtime(SystemTools::readMemAvailableMiB());
+			}
+			if (!frameBuf) break;
+			const iovec seg{ frameBuf.data(),
+				renderRealTime(frameBuf.data(), conn.subType, conn.subHeight, conn.subWidth) };
+			const replyTag tag{ conn.protoVersion, FRAME_FLAG_PUSH, cmdEnum::subscribeRealTime,
+				conn.subRequestId };
+			sendReply(fd, conn, tag, &seg, 1);
+			pushedFds.emplace_back(fd);
+		}
+
+		for (const int fd : pushedFds) {
+			auto it = connMap.find(fd);
+			if (it != connMap.end())
+				updateConn(fd, it->second);
+		}
+	}
+
+	void workerThreadFunc() {
+		Trace::setThreadName("worker");
+
+		while (true) {
+			jobStruct job;
+			{
+				std::unique_lock<mutex> lock(jobMutex);
+				jobCV.wait(lock, [this] { return !jobQueue.empty(); });
+				job = move(jobQueue.front());
+				jobQueue.pop_front();
+				if (job.asyncId) {
+					auto it = asyncJobMap.find(job.asyncId);
+					if (it != asyncJobMap.end()) it->second.state = JOB_RUNNING;
 				}
+			}
 
-				recvBuf[recvLen] = 0;
-				handleCmd(appCommand, recvLen, clnt_sock);
+			// 异步任务先收集原始回应, 记录后再打包为推送帧
+			string result;
+			runningAsyncId = job.asyncId;
+			auto replyBuf = BufferPool::acquire(REPLY_BUF_SIZE, BufferPool::OWNER_SERVER);
+			if (replyBuf) {
+				handleCmd(job.tag.command, static_cast<int>(job.data.length()), job.data.data(),
+					replyBuf.data(), REPLY_BUF_SIZE, replyCollector{ result });
 			}
-			close(serv_sock);
+			else result = "内存不足";
+			runningAsyncId = 0;
+
+			replyTag tag = job.tag;
+			if (job.asyncId) tag.flags |= FRAME_FLAG_PUSH;
+			vector<iovec> iov;
+			frameHeaderV2 header;
+			const iovec seg{ result.data(), result.length() };
+			packReply(&header, tag, &seg, 1, iov);
+			job.data.clear();
+			appendIov(job.data, iov.data(), iov.size(), 0);
+
+			{
+				lock_guard<mutex> lock(jobMutex);
+				if (job.asyncId) finishAsyncJob(job.asyncId, move(result));
+				doneQueue.emplace_back(move(job));
+			}
+			const uint64_t one = 1;
+			if (write(doneEventFd, &one, sizeof(one)) != sizeof(one))
+				fprintf(stderr, "%s() 通知失败 [%d]:[%s]", __FUNCTION__, errno, strerror(errno));
+		}
+	}
+
+	// req: 请求数据, 末尾有终止符; reply: 回应缓存, 容量 replyCap
+	// replyFunc(seg, segCnt): 发出回应, 每个命令恰好调用一次
+	template<typename ReplyFunc>
+	void handleCmd(const int appCommand, const int recvLen, char* req, char* reply, const size_t replyCap,
+		ReplyFunc&& replyFunc) {
+		Metrics::scopedTimer requestTimer(Metrics::serverRequest.at(appCommand));
+
+		// 回应过大无法缓存的, 不经收集直接零拷贝回应
+		const uint32_t ttlMs = getCacheTtlMs(appCommand);
+		if (ttlMs == 0 || !ReplyCache::isStorable(minReplyLen(appCommand, req, recvLen))) {
+			execCmd(appCommand, recvLen, req, reply, replyCap, replyFunc);
+			if (isInvalidateCacheCmd(appCommand))
+				replyCache.invalidate();
+			return;
+		}
+
+		// getRealTimeInfo 的 availableMiB 由客户端提供并出现在回应中, 需保留在键中,
+		// 否则会拿到其他请求的内存数值
+		const string key(req, recvLen);
+		string cached;
+		if (replyCache.lookup(appCommand, key, cached)) {
+			Metrics::replyCacheHit.inc(appCommand);
+		}
+		else {
+			Metrics::replyCacheMiss.inc(appCommand);
+			execCmd(appCommand, recvLen, req, reply, replyCap, replyCollector{ cached });
+			replyCache.store(appCommand, key, cached, ttlMs);
 		}
+		const iovec seg{ cached.data(), cached.length() };
+		replyFunc(&seg, 1);
 	}
 
-	void handleCmd(const int appCommand, const int recvLen, const int clnt_sock) {
-		char* replyPtr;
-		uint32_t replyLen;
+	template<typename ReplyFunc>
+	void execCmd(const int appCommand, const int recvLen, char* req, char* reply, const size_t replyCap,
+		ReplyFunc&& replyFunc) {
+		TRACE_SCOPE_ARG(__FUNCTION__, appCommand);
+		char* replyPtr = nullptr;
+		uint32_t replyLen = 0;
+		bool isReplied = false;
 		switch (appCommand) {
 		case cmdEnum::getPropInfo: {
-			replyPtr = replyBuf.get();
-			replyLen = freezeit.formatProp(replyBuf.get(), REPLY_BUF_SIZE,
+			replyPtr = reply;
+			replyLen = freezeit.formatProp(reply, replyCap,
 				systemTools.cpuCluster);
 		} break;
 
@@ -217,54 +1009,97 @@ public:
 		} break;
 
 		case cmdEnum::getLog: {
-			replyPtr = freezeit.getLogPtr();
-			replyLen = freezeit.getLoglen();
+			sendLog(replyFunc);
+			isReplied = true;
+		} break;
+
+		case cmdEnum::getLogSince: {
+			if (recvLen != 16) {
+				replyPtr = reply;
+				replyLen = snprintf(reply, 128, "日志游标需要16字节, 实际收到[%u]", recvLen);
+				break;
+			}
+
+			uint64_t cursor[2]; // [epoch, seq]
+			memcpy(cursor, req, sizeof(cursor));
+			const bool isSameEpoch = cursor[0] == freezeit.logEpoch;
+			freezeit.snapshotLog([&](const iovec* seg, const int segCnt, const uint64_t startSeq,
+				const uint64_t endSeq) {
+					uint64_t head[4] = { freezeit.logEpoch, startSeq, endSeq, 0 };
+					head[3] = (!isSameEpoch || startSeq != cursor[1]) ? 1 : 0;
+					vector<iovec> iov;
+					iov.reserve(segCnt + 1);
+					iov.emplace_back(iovec{ head, sizeof(head) });
+					iov.insert(iov.end(), seg, seg + segCnt);
+					replyFunc(iov.data(), static_cast<int>(iov.size()));
+				}, isSameEpoch ? cursor[1] : 0, true);
+			isReplied = true;
+		} break;
+
+		case cmdEnum::getEvents: {
+			if (recvLen != 8) {
+				replyPtr = reply;
+				replyLen = snprintf(reply, 128, "事件查询需要8字节, 实际收到[%u]", recvLen);
+				break;
+			}
+
+			int32_t uid;
+			uint32_t typeMask;
+			memcpy(&uid, req, 4);
+			memcpy(&typeMask, req + 4, 4);
+
+			const uint32_t len = freezeit.queryEvents(uid, typeMask, reply + 4,
+				replyCap - 4);
+			const uint32_t cnt = len / sizeof(eventRecord);
+			memcpy(reply, &cnt, 4);
+
+			replyPtr = reply;
+			replyLen = 4 + len;
 		} break;
 
 		case cmdEnum::getAppCfg: {
 			uint32_t intLen = 0;
-			const auto ptr = reinterpret_cast<int*>(replyBuf.get());
+			const auto ptr = reinterpret_cast<int*>(reply);
+			const auto appListLock = managedApp.lockAppList();
 			for (const auto& [uid, info] : managedApp.getRaw()) {
 				ptr[intLen++] = uid;
 				ptr[intLen++] = static_cast<int>(info.freezeMode);
 				ptr[intLen++] = info.isTolerant ? 1 : 0;
 			}
 
-			replyPtr = replyBuf.get();
+			replyPtr = reply;
 			replyLen = intLen << 2; // intLen*sizeof(int)
 		} break;
 
 		case cmdEnum::getRealTimeInfo: {
-			if (recvLen != 12) {
-				replyPtr = replyBuf.get();
-				replyLen = snprintf(replyBuf.get(), 128, "实时信息需要12字节, 实际收到[%u]",
+			if (recvLen != 12 && recvLen != 16) {
+				replyPtr = reply;
+				replyLen = snprintf(reply, 128, "实时信息需要12或16字节, 实际收到[%u]",
 					recvLen);
 				break;
 			}
 
-			uint32_t height = ((uint32_t*)recvBuf.get())[0];
-			uint32_t width = ((uint32_t*)recvBuf.get())[1];
+			uint32_t height = ((uint32_t*)req)[0];
+			uint32_t width = ((uint32_t*)req)[1];
+			const uint32_t type = recvLen == 16 ? ((uint32_t*)req)[3] : REALTIME_CHART;
 
-			if (height < 20 || width < 20) {
-				replyPtr = replyBuf.get();
-				replyLen = snprintf(replyBuf.get(), 128, "宽高不符合, height[%u] width[%u]",
-					height, width);
+			if (type > REALTIME_SERIES || (type == REALTIME_CHART && (height < 20 || width < 20))) {
+				replyPtr = reply;
+				replyLen = snprintf(reply, 128, "参数不符合, type[%u] height[%u] width[%u]",
+					type, height, width);
 				break;
 			}
 
-			auto& availableMiB = ((uint32_t*)recvBuf.get())[2]; // Unit: MiB
+			auto& availableMiB = ((uint32_t*)req)[2]; // Unit: MiB
 
 			systemTools.getCPU_realtime(availableMiB);
-			replyLen = systemTools.drawChart((uint32_t*)replyBuf.get(), height,
-				width);
-			replyLen += systemTools.formatRealTime(
-				reinterpret_cast<int*>(replyBuf.get() + replyLen));
-			replyPtr = replyBuf.get();
+			replyLen = renderRealTime(reply, type, height, width);
+			replyPtr = reply;
 		} break;
 
 		case cmdEnum::getUidTime: {
 			int intLen = 0;
-			int* ptr = reinterpret_cast<int*>(replyBuf.get());
+			int* ptr = reinterpret_cast<int*>(reply);
 			struct st {
 				int uid;
 				int total;
@@ -272,6 +1107,7 @@ public:
 			};
 			vector<st> uidTimeSort;
 			uidTimeSort.reserve(128);
+			const auto appListLock = managedApp.lockAppList();
 			for (const auto& [uid, timeList] : doze.updateUidTime())
 				uidTimeSort.emplace_back(st{ uid, timeList.total, timeList.lastTotal });
 
@@ -284,7 +1120,7 @@ public:
 				ptr[intLen++] = total;
 			}
 
-			replyPtr = replyBuf.get();
+			replyPtr = reply;
 			replyLen = intLen << 2; // intLen*sizeof(int)
 		} break;
 
@@ -295,17 +1131,19 @@ public:
 
 		case cmdEnum::setAppCfg: {
 			if (recvLen == 0 || (recvLen % 12)) {
-				replyPtr = replyBuf.get();
-				replyLen = snprintf(replyBuf.get(), 128, "需要12字节的倍数, 实际收到[%u]",
+				replyPtr = reply;
+				replyLen = snprintf(reply, 128, "需要12字节的倍数, 实际收到[%u]",
 					recvLen);
-				freezeit.log(replyBuf.get());
+				freezeit.log(reply);
 				break;
 			}
 
-			managedApp.updateAppList();
+			setJobStage("更新应用列表");
+			const auto appListLock = managedApp.lockAppList();
+			managedApp.syncAppList();
 
 			const int intSize = recvLen >> 2; // recvLen/4
-			const int* ptr = reinterpret_cast<int*>(recvBuf.get());
+			const int* ptr = reinterpret_cast<const int*>(req);
 			map<int, cfgStruct> newCfg;
 
 			for (int i = 0; i < intSize;) {
@@ -339,21 +1177,25 @@ public:
 				freezeit.log("配置变化：\n\n%s", tips.c_str());
 
 			// auto runningUids = freezer.getRunningUids(uidSet);
+			setJobStage("查找策略变更的应用进程 (%zu款)", uidSet.size());
 			auto runningPids = freezer.getRunningPids(uidSet);
 			tips.clear();
 			for (const auto& [uid, pids] : runningPids) {
 				tips += "\n" + managedApp[uid].label;
 				for (const int pid : pids)
 					tips += " " + to_string(pid);
-				freezer.handleSignal(uid, pids, SIGKILL);
 			}
+			setJobStage("杀死策略变更的应用 (%zu款)", runningPids.size());
+			freezer.killApps(runningPids);
 			if (tips.length())
 				freezeit.log("杀死策略变更的应用: \n%s\n", tips.c_str());
 
+			setJobStage("应用并保存配置");
 			managedApp.loadConfig2CfgTemp(newCfg);
 			managedApp.updateIME2CfgTemp();
 			managedApp.applyCfgTemp();
 			managedApp.saveConfig();
+			setJobStage("同步配置到Xposed");
 			managedApp.update2xposedByLocalSocket();
 
 			replyPtr = const_cast<char*>("success");
@@ -361,10 +1203,12 @@ public:
 		} break;
 
 		case cmdEnum::setAppLabel: {
-			managedApp.updateAppList(); // 先更新应用列表
+			setJobStage("更新应用列表");
+			const auto appListLock = managedApp.lockAppList();
+			managedApp.syncAppList(); // 先更新应用列表
 
 			map<int, string> labelList;
-			for (const string& str : Utils::splitString(string(recvBuf.get(), recvLen),
+			for (const string& str : Utils::splitString(string(req, recvLen),
 				"\n")) {
 				const int uid = atoi(str.c_str());
 				if (managedApp.without(uid) || str.length() <= 6)
@@ -382,6 +1226,7 @@ public:
 			freezeit.log("更新 %lu 款应用名称:\n\n%s\n", labelList.size(), labelStr.c_str());
 
 			managedApp.loadLabel(labelList);
+			setJobStage("同步名称到Xposed");
 			managedApp.update2xposedByLocalSocket();
 			managedApp.saveLabel();
 
@@ -391,29 +1236,80 @@ public:
 
 		case cmdEnum::clearLog: {
 			freezeit.clearLog();
-			replyPtr = freezeit.getLogPtr();
-			replyLen = freezeit.getLoglen();
+			sendLog(replyFunc);
+			isReplied = true;
 		} break;
 
 		case cmdEnum::getProcState: {
-			freezer.printProcState();
-			replyPtr = freezeit.getLogPtr();
-			replyLen = freezeit.getLoglen();
+			{
+				const auto appListLock = managedApp.lockAppList();
+				freezer.printProcState();
+			}
+			sendLog(replyFunc);
+			isReplied = true;
+		} break;
+
+		case cmdEnum::getTraceStat: {
+			replyPtr = reply;
+			replyLen = Trace::formatStat(reply, replyCap);
+			if (recvLen == 1 && req[0])
+				Trace::resetAll();
+		} break;
+
+		case cmdEnum::getMetrics: {
+			replyPtr = reply;
+			replyLen = Metrics::formatBinary(reply, replyCap);
+		} break;
+
+		case cmdEnum::getMetricsText: {
+			replyPtr = reply;
+			replyLen = Metrics::formatText(reply, replyCap);
+		} break;
+
+		case cmdEnum::getTraceJson: {
+			replyPtr = reply;
+			replyLen = Trace::formatJson(reply, replyCap);
+		} break;
+
+		case cmdEnum::getMemStats: {
+			replyPtr = reply;
+			replyLen = systemTools.formatMemStats(reply, replyCap);
+		} break;
+
+		case cmdEnum::getSelfCost: {
+			replyPtr = reply;
+			replyLen = systemTools.formatSelfCost(reply, replyCap);
+		} break;
+
+		case cmdEnum::getJobState: {
+			replyPtr = reply;
+			if (recvLen != 4) {
+				replyLen = snprintf(reply, 128, "任务查询需要4字节, 实际收到[%u]", recvLen);
+				break;
+			}
+			uint32_t asyncId;
+			memcpy(&asyncId, req, 4);
+			replyLen = formatJobState(asyncId, reply, replyCap);
+		} break;
+
+		case cmdEnum::getBatch: {
+			handleBatch(recvLen, req, reply, replyCap, replyFunc);
+			isReplied = true;
 		} break;
 
 		case cmdEnum::setSettingsVar: {
-			replyPtr = replyBuf.get();
+			replyPtr = reply;
 
 			if (recvLen != 2) {
-				replyLen = snprintf(replyBuf.get(), REPLY_BUF_SIZE,
+				replyLen = snprintf(reply, replyCap,
 					"数据长度不正确, 正常:2, 收到:%d", recvLen);
 				break;
 			}
 
-			int len = settings.checkAndSet(recvBuf[0], recvBuf[1], replyBuf.get());
+			int len = settings.checkAndSet(req[0], req[1], reply);
 
 			if (len <= 0) {
-				memcpy(replyBuf.get(), "未知设置错误", 18);
+				memcpy(reply, "未知设置错误", 18);
 				replyLen = 18;
 			}
 			else {
@@ -427,11 +1323,191 @@ public:
 		} break;
 		}
 
-		if (replyLen) {
-			uint32_t header[2] = { replyLen , 0 };
-			send(clnt_sock, header, 6, MSG_DONTROUTE);
-			send(clnt_sock, replyPtr, replyLen, MSG_DONTROUTE);
+		if (!isReplied) {
+			const iovec seg{ replyPtr, replyLen };
+			replyFunc(&seg, 1);
+		}
+	}
+
+	// 回应头部写入 header, v1 为6字节 [4字节数据长度 2字节保留], 订阅推送帧的保留字节[0]为订阅命令
+	// v2 为 frameHeaderV2; 数据可为空. 保持连接, 客户端可在同一连接上继续发送请求
+	static void packReply(frameHeaderV2* header, const replyTag& tag, const iovec* seg, const int segCnt,
+		vector<iovec>& iov) {
+		uint32_t dataLen = 0, crc = 0;
+		iov.clear();
+		iov.reserve(segCnt + 1);
+		iov.emplace_back(iovec{ header, 0 });
+		for (int i = 0; i < segCnt; i++) {
+			if (seg[i].iov_len == 0) continue;
+			dataLen += seg[i].iov_len;
+			if (tag.protoVersion == 2)
+				crc = Utils::crc32c(seg[i].iov_base, seg[i].iov_len, crc);
+			iov.emplace_back(seg[i]);
+		}
+
+		if (tag.protoVersion == 2) {
+			*header = frameHeaderV2{ FRAME_MAGIC, FRAME_VERSION, tag.flags, tag.command, tag.requestId,
+				dataLen, crc };
+			iov[0].iov_len = sizeof(frameHeaderV2);
+		}
+		else {
+			auto ptr = reinterpret_cast<uint8_t*>(header);
+			memcpy(ptr, &dataLen, 4);
+			ptr[4] = (tag.flags & FRAME_FLAG_PUSH) ? static_cast<uint8_t>(tag.command) : 0;
+			ptr[5] = 0;
+			iov[0].iov_len = 6;
+		}
+	}
+
+	// 将 iov 中 跳过前 skip 字节后的数据追加到 out
+	static void appendIov(string& out, const iovec* iov, const size_t iovCnt, size_t skip) {
+		for (size_t i = 0; i < iovCnt; i++) {
+			if (skip >= iov[i].iov_len) {
+				skip -= iov[i].iov_len;
+				continue;
+			}
+			out.append(static_cast<const char*>(iov[i].iov_base) + skip, iov[i].iov_len - skip);
+			skip = 0;
+		}
+	}
+
+	void sendReply(const int fd, connStruct& conn, const replyTag& tag, const iovec* seg, const int segCnt) {
+		vector<iovec> iov;
+		frameHeaderV2 header;
+		packReply(&header, tag, seg, segCnt, iov);
+		sendBytes(fd, conn, iov.data(), static_cast<int>(iov.size()));
+	}
+
+	// 非阻塞发送, 每次 sendmsg 至多 IOV_MAX 段, 发不完的部分复制到 outBuf 待可写时继续
+	void sendBytes(const int fd, connStruct& conn, const iovec* iov, const int iovCnt) {
+		if (!conn.outBuf.empty()) {
+			appendIov(conn.outBuf, iov, iovCnt, 0);
+			return;
 		}
-		close(clnt_sock);
+
+		size_t sent = 0;
+		int idx = 0;
+		size_t skip = 0; // iov[idx] 已发送的字节
+		while (idx < iovCnt) {
+			iovec batch[IOV_MAX];
+			int batchCnt = 0;
+			for (int i = idx; i < iovCnt && batchCnt < IOV_MAX; i++, batchCnt++) {
+				batch[batchCnt] = iov[i];
+				if (i == idx) {
+					batch[batchCnt].iov_base = static_cast<char*>(iov[i].iov_base) + skip;
+					batch[batchCnt].iov_len -= skip;
+				}
+			}
+
+			msghdr msg{};
+			msg.msg_iov = batch;
+			msg.msg_iovlen = batchCnt;
+			const ssize_t len = sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (len < 0) {
+				if (errno == EINTR) continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+				fprintf(stderr, "%s() 发送失败 [%d]:[%s]", __FUNCTION__, errno, strerror(errno));
+				conn.isBroken = true;
+				return;
+			}
+			sent += len;
+
+			// 跳过已发送部分
+			size_t remain = len + skip;
+			while (idx < iovCnt && remain >= iov[idx].iov_len) {
+				remain -= iov[idx].iov_len;
+				idx++;
+			}
+			skip = remain;
+		}
+
+		if (sent) conn.lastActive = nowSec();
+		if (idx < iovCnt) {
+			conn.outOffset = 0;
+			appendIov(conn.outBuf, iov + idx, iovCnt - idx, skip);
+		}
+	}
+
+	void flushOut(const int fd, connStruct& conn) {
+		while (conn.outOffset < conn.outBuf.length()) {
+			const ssize_t len = send(fd, conn.outBuf.data() + conn.outOffset,
+				conn.outBuf.length() - conn.outOffset, MSG_DONTWAIT | MSG_NOSIGNAL);
+			if (len < 0) {
+				if (errno == EINTR) continue;
+				if (errno != EAGAIN && errno != EWOULDBLOCK)
+					conn.isBroken = true;
+				return;
+			}
+			conn.outOffset += len;
+			conn.lastActive = nowSec();
+		}
+		conn.outBuf.clear();
+		conn.outBuf.shrink_to_fit();
+		conn.outOffset = 0;
+	}
+
+	// 子命令的回应函数, 用固定类型而非lambda, 避免 handleCmd/handleBatch 模板无限递归实例化
+	struct batchItemReply {
+		string& out;
+		const size_t headerIdx;
+
+		void operator()(const iovec* seg, const int segCnt) const {
+			appendIov(out, seg, segCnt, 0);
+			const uint32_t len = out.length() - headerIdx - sizeof(batchItem);
+			memcpy(out.data() + headerIdx + offsetof(batchItem, length), &len, sizeof(len));
+		}
+	};
+
+	// 逐个执行子命令, 各子回应依次拼接为 [batchItem + reply], 最后一次性回应
+	// 子命令共用 reply 缓存, 回应在下一个子命令执行前已复制
+	template<typename ReplyFunc>
+	void handleBatch(const int recvLen, const char* req, char* reply, const size_t replyCap, ReplyFunc&& replyFunc) {
+		string batchReply;
+		string subReq;
+		int offset = 0;
+		while (offset < recvLen) {
+			batchItem item;
+			if (recvLen - offset < static_cast<int>(sizeof(item))) break;
+			memcpy(&item, req + offset, sizeof(item));
+			offset += sizeof(item);
+			if (item.length > static_cast<uint32_t>(recvLen - offset)) {
+				offset = -1;
+				break;
+			}
+
+			subReq.assign(req + offset, item.length); // 子命令数据需要终止符
+			offset += item.length;
+
+			batchItemReply subReplyFunc{ batchReply, batchReply.length() };
+			batchReply.append(reinterpret_cast<const char*>(&item), sizeof(item));
+
+			if (isBatchableCmd(item.command)) {
+				handleCmd(item.command, item.length, subReq.data(), reply, replyCap, subReplyFunc);
+			}
+			else {
+				char tips[64];
+				const int len = snprintf(tips, sizeof(tips), "不支持批量执行的命令[%u]", item.command);
+				const iovec seg{ tips, static_cast<size_t>(len) };
+				subReplyFunc(&seg, 1);
+			}
+		}
+
+		if (offset != recvLen) {
+			const int len = snprintf(reply, 128, "批量命令格式错误, 长度[%d] 解析至[%d]", recvLen, offset);
+			const iovec seg{ reply, static_cast<size_t>(len) };
+			replyFunc(&seg, 1);
+			return;
+		}
+
+		const iovec seg{ batchReply.data(), batchReply.length() };
+		replyFunc(&seg, 1);
+	}
+
+	// 日志在持锁期间从环形缓冲区发出, 仅事件记录需渲染, 未能立即发出的部分复制后再发
+	template<typename ReplyFunc>
+	void sendLog(ReplyFunc&& replyFunc) {
+		freezeit.snapshotLog([&](const iovec* seg, const int segCnt, uint64_t, uint64_t) {
+			replyFunc(seg, segCnt);
+			});
 	}
 };
@@ -2,13 +2,15 @@
 
 #include "utils.hpp"
 #include "freezeit.hpp"
+#include "configStore.hpp"
 
 class Settings {
 private:
 	Freezeit& freezeit;
+	ConfigStore& configStore;
 	mutex writeSettingMutex;
 
-	string settingsPath;
+	string settingsPath; // 旧版设置文件, 仅用于迁移到配置库
 
 	const static size_t SETTINGS_SIZE = 256;
 	uint8_t settingsVar[SETTINGS_SIZE] = {
@@ -19,7 +21,7 @@ private:
 			20, //[4] terminateTimeout sec
 			5,  //[5] setMode
 			2,  //[6] refreezeTimeout
-			0,  //[7]
+			0,  //[7] 日志文件轮转大小 MiB, 0:默认1MiB
 			0,  //[8]
 			0,  //[9]
 			1,  //[10] 激进前台识别
@@ -41,7 +43,7 @@ private:
 			0,  //[26]
 			0,  //[27]
 			0,  //[28]
-			0,  //[29]
+			0,  //[29] 函数耗时统计
 			0,  //[30] Doze调试日志
 			0,  //[31] Binder检测
 			0,  //[32]
@@ -55,6 +57,7 @@ public:
 	uint8_t& terminateTimeout = settingsVar[4];  // 单位 秒
 	uint8_t& setMode = settingsVar[5];           // Freezer模式
 	uint8_t& refreezeTimeoutIdx = settingsVar[6];// 定时压制 参数索引 0-4
+	uint8_t& logFileSizeMiB = settingsVar[7];    // 日志文件轮转大小 单位 MiB 0-32
 
 	uint8_t& enableBatteryMonitor = settingsVar[13];   // 电池监控
 	uint8_t& enableCurrentFix = settingsVar[14];       // 电池电流校准
@@ -62,20 +65,18 @@ public:
 	uint8_t& enableLMK = settingsVar[16];              // 调整 lmk 参数 仅安卓11-15
 	uint8_t& enableDoze = settingsVar[17];             // 深度Doze
 
+	uint8_t& enableTrace = settingsVar[29];              // 函数耗时统计
 	uint8_t& enableScreenDebug = settingsVar[30];        // Doze调试日志
 	uint8_t& BinderFreezer = settingsVar[31];//Binder检测
 	Settings& operator=(Settings&&) = delete;
 
-	Settings(Freezeit& freezeit) : freezeit(freezeit) {
+	Settings(Freezeit& freezeit, ConfigStore& configStore) : freezeit(freezeit), configStore(configStore) {
 
 		settingsPath = freezeit.modulePath + "/settings.db";
 
-		auto fd = open(settingsPath.c_str(), O_RDONLY);
-		if (fd > 0) {
-			uint8_t tmp[SETTINGS_SIZE] = { 0 };
-			int readSize = read(fd, tmp, SETTINGS_SIZE);
-			close(fd);
-
+		uint8_t tmp[SETTINGS_SIZE] = { 0 };
+		const int readSize = readSaved(tmp);
+		if (readSize >= 0) {
 			if (readSize != SETTINGS_SIZE) {
 				freezeit.log("设置文件校验失败, 将使用默认设置参数, 并更新设置文件");
 				freezeit.log("读取大小: %d Bytes.  要求大小: 256 Bytes.", readSize);
@@ -122,14 +123,45 @@ public:
 					terminateTimeout = 30;
 					isError = true;
 				}
+				if (logFileSizeMiB > 32) {
+					freezeit.log("日志文件大小参数[%d]错误, 已重置为默认1MiB", static_cast<int>(logFileSizeMiB));
+					logFileSizeMiB = 0;
+					isError = true;
+				}
 				if (isError)
 					freezeit.log(save() ? "⚙️设置成功" : "🔧设置文件写入失败");
+				else if (configStore.isNew())
+					freezeit.log(save() ? "⚙️设置已迁移到配置库" : "🔧设置文件写入失败");
 			}
 		}
 		else {
 			freezeit.log("设置文件不存在, 将初始化设置文件");
 			freezeit.log(save() ? "⚙️设置成功" : "🔧设置文件写入失败");
 		}
+
+		freezeit.setLogFileSize(logFileSizeMiB);
+		Trace::setEnable(enableTrace);
+	}
+
+	// 读取已保存的设置, 返回读取的字节数, -1:不存在
+	// 配置库为新建时读取旧版设置文件
+	int readSaved(uint8_t* buf) {
+		if (!configStore.isNew()) { // 缺少的项(快照损坏后只从日志恢复了部分)取默认值
+			int readSize = 0;
+			memcpy(buf, settingsVar, SETTINGS_SIZE);
+			configStore.forEach(ConfigStore::SECTION_SETTINGS, [&](const string_view key, const string_view value) {
+				if (key.length() != 1 || value.length() != 1) return;
+				buf[static_cast<uint8_t>(key[0])] = value[0];
+				readSize++;
+				});
+			return readSize ? SETTINGS_SIZE : -1;
+		}
+
+		auto fd = open(settingsPath.c_str(), O_RDONLY);
+		if (fd < 0) return -1;
+		int readSize = read(fd, buf, SETTINGS_SIZE);
+		close(fd);
+		return readSize;
 	}
 
 	uint8_t& operator[](int key) {
@@ -169,20 +201,13 @@ public:
 		return timeoutList[refreezeTimeoutIdx < 5 ? refreezeTimeoutIdx : 0];
 	}
 
+	// 每项一条记录, 配置库只追加有变化的项
 	bool save() {
 		lock_guard<mutex> lock(writeSettingMutex);
-		auto fd = open(settingsPath.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0666);
-		if (fd > 0) {
-			int writeSize = write(fd, settingsVar, SETTINGS_SIZE);
-			close(fd);
-			if (writeSize == SETTINGS_SIZE)
-				return true;
-
-			const char* fmt = "设置异常, 文件实际写入[%d]Bytes";
-			freezeit.log(fmt, writeSize);
-			fprintf(stderr, fmt, writeSize);
-		}
-		return false;
+		ConfigStore::sectionMap section;
+		for (size_t i = 0; i < SETTINGS_SIZE; i++)
+			section.emplace(string(1, static_cast<char>(i)), string(1, static_cast<char>(settingsVar[i])));
+		return configStore.replaceSection(ConfigStore::SECTION_SETTINGS, std::move(section));
 	}
 
 	int checkAndSet(int idx, int val, char* replyBuf) {
@@ -225,6 +250,13 @@ public:
 		}
 			  break;
 
+		case 7: { // 日志文件轮转大小 MiB
+			if (32 < val)
+				return snprintf(replyBuf, REPLY_BUF_SIZE, "日志文件大小参数错误, 正常范围:0~32, 欲设为:%d", val);
+			freezeit.setLogFileSize(val);
+		}
+			  break;
+
 		case 10: // xxx
 		case 11: // xxx
 		case 12: // xxx
@@ -244,7 +276,6 @@ public:
 		case 26: //
 		case 27: //
 		case 28: //
-		case 29: //
 		case 30: // Doze调试日志
 		case 31:
 		{
@@ -253,6 +284,13 @@ public:
 		}
 		break;
 
+		case 29: { // 函数耗时统计
+			if (val != 0 && val != 1)
+				return snprintf(replyBuf, REPLY_BUF_SIZE, "开关值错误, 正常范围:0/1, 欲设为:%d", val);
+			Trace::setEnable(val);
+		}
+			   break;
+
 		default: {
 			freezeit.log("🔧设置失败，设置项不存在, [%d]:[%d]", idx, val);
 			return snprintf(replyBuf, REPLY_BUF_SIZE, "设置项不存在, [%d]:[%d]", idx, val);
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <ctime>
+#include <algorithm>
+#include <bit>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+// 包名、应用名称的字符串池: 内容追加存放于内存块, 相同内容只存一份, 以 istr(4字节编号) 引用
+// 编号在回收前不变, 两个 istr 相等即编号相等
+// 回收(collect): 持有者标记仍在使用的编号, 其余编号释放, 存活内容搬到新内存块, 编号不变
+// 旧内存块及释放的编号延迟 RETIRE_SEC 秒后由 trim() 释放/复用, 其他线程已取得的 c_str() 短时间内仍可读
+namespace StrArena {
+	constexpr size_t BLOCK_SIZE = 4096;
+	constexpr uint32_t CHUNK_SHIFT = 9;
+	constexpr uint32_t CHUNK_SIZE = 1 << CHUNK_SHIFT; // 每组 512 个编号, 组按需分配
+	constexpr uint32_t CHUNK_CNT = 64;                // 编号上限 32768
+	constexpr size_t COLLECT_MIN_BYTES = 4096;        // 待回收超过此值且超过存活的 1/4 才搬迁
+	constexpr int RETIRE_SEC = 10;
+
+	struct entry {
+		std::atomic<const char*> ptr; // 回收时搬迁, 其他线程不加锁读取
+		uint32_t len;
+		bool isUsed;
+		bool isPinned; // 常量, 不回收
+	};
+
+	struct block {
+		std::unique_ptr<char[]> data;
+		size_t size;
+	};
+
+	inline std::mutex arenaMutex;
+	inline std::unique_ptr<entry[]> chunks[CHUNK_CNT]; // 组指针分配后不再变化, 按编号读取无需加锁
+	inline uint32_t entryCnt = 1;                      // 编号0 为空串, 不占存储
+	inline uint32_t usedCnt = 0;
+	inline std::vector<uint32_t> freeIds;
+	inline std::vector<uint32_t> retiredIds;           // 回收释放的编号, 随旧内存块一起到期后才复用
+	inline std::vector<uint32_t> hashSlots;            // 开放寻址, 存编号, 0:空槽
+	inline std::vector<block> blocks;
+	inline size_t blockUsed = 0;                       // 末块已用字节
+	inline size_t blockBytes = 0, contentBytes = 0;
+	inline std::vector<block> retiredBlocks;
+	inline size_t retiredBytes = 0;
+	inline time_t retireTime = 0;
+	inline uint64_t collectCnt = 0;
+
+	inline entry& entryAt(const uint32_t id) { return chunks[id >> CHUNK_SHIFT][id & (CHUNK_SIZE - 1)]; }
+
+	inline std::string_view view(const uint32_t id) {
+		if (id == 0) return {};
+		const entry& e = entryAt(id);
+		return { e.ptr.load(std::memory_order_acquire), e.len };
+	}
+
+	// 以下需持有 arenaMutex *****************
+
+	// 返回槽位: 已存在则槽内为其编号, 否则为应放入的空槽
+	inline uint32_t& probe(const std::string_view str) {
+		const size_t mask = hashSlots.size() - 1;
+		for (size_t i = std::hash<std::string_view>{}(str) & mask;; i = (i + 1) & mask) {
+			uint32_t& slot = hashSlots[i];
+			if (slot == 0 || view(slot) == str) return slot;
+		}
+	}
+
+	// 负载不超过 1/2
+	inline void rehash(const size_t minCnt) {
+		hashSlots.assign(std::bit_ceil(std::max<size_t>(64, minCnt * 2)), 0);
+		for (uint32_t id = 1; id < entryCnt; id++)
+			if (entryAt(id).isUsed) probe(view(id)) = id;
+	}
+
+	inline const char* store(const std::string_view str) {
+		const size_t size = str.length() + 1;
+		if (blocks.empty() || blocks.back().size - blockUsed < size) {
+			const size_t blockSize = std::max(BLOCK_SIZE, size);
+			blocks.emplace_back(block{ std::make_unique<char[]>(blockSize), blockSize });
+			blockBytes += blockSize;
+			blockUsed = 0;
+		}
+		char* ptr = blocks.back().data.get() + blockUsed;
+		memcpy(ptr, str.data(), str.length());
+		ptr[str.length()] = 0;
+		blockUsed += size;
+		contentBytes += size;
+		return ptr;
+	}
+
+	// *****************************************
+
+	// 入池并返回编号, 空串为0
+	inline uint32_t intern(const std::string_view str, const bool isPinned = false) {
+		if (str.empty()) return 0;
+
+		std::lock_guard<std::mutex> lock(arenaMutex);
+		if (hashSlots.size() < (usedCnt + 1) * 2)
+			rehash(usedCnt + 1);
+
+		uint32_t& slot = probe(str);
+		if (slot) {
+			if (isPinned) entryAt(slot).isPinned = true;
+			return slot;
+		}
+
+		uint32_t id;
+		if (freeIds.size()) {
+			id = freeIds.back();
+			freeIds.pop_back();
+		}
+		else {
+			if (entryCnt == CHUNK_SIZE * CHUNK_CNT) {
+				fprintf(stderr, "StrArena 编号已用尽, 丢弃 [%.*s]", static_cast<int>(str.length()), str.data());
+				return 0;
+			}
+			id = entryCnt;
+			auto& chunk = chunks[id >> CHUNK_SHIFT];
+			if (!chunk) chunk = std::make_unique<entry[]>(CHUNK_SIZE);
+			entryCnt++;
+		}
+
+		entry& e = entryAt(id);
+		e.len = static_cast<uint32_t>(str.length());
+		e.isUsed = true;
+		e.isPinned = isPinned;
+		e.ptr.store(store(str), std::memory_order_release);
+		usedCnt++;
+		slot = id;
+		return id;
+	}
+
+	// 只查找, 不存在返回0
+	inline uint32_t find(const std::string_view str) {
+		if (str.empty()) return 0;
+
+		std::lock_guard<std::mutex> lock(arenaMutex);
+		return hashSlots.empty() ? 0 : probe(str);
+	}
+
+	// 周期调用, 释放延迟期已过的旧内存块, 其间释放的编号可以复用
+	inline void trim() {
+		std::lock_guard<std::mutex> lock(arenaMutex);
+		if (retiredBlocks.empty() || time(nullptr) - retireTime < RETIRE_SEC) return;
+		retiredBlocks.clear();
+		retiredBytes = 0;
+		freeIds.insert(freeIds.end(), retiredIds.begin(), retiredIds.end());
+		retiredIds.clear();
+	}
+
+	inline size_t formatStats(char* buf, const size_t maxLen) {
+		std::lock_guard<std::mutex> lock(arenaMutex);
+		const size_t len = snprintf(buf, maxLen,
+			"字符串池 %u 项, 内容 %zu B, 内存块 %zu KiB, 待释放 %zu KiB, 已回收 %llu 次\n",
+			usedCnt, contentBytes, blockBytes >> 10, retiredBytes >> 10, (unsigned long long)collectCnt);
+		return std::min(len, maxLen);
+	}
+}
+
+// 池内字符串的引用, 比较只比较编号; 与其他字符串比较时按内容
+class istr {
+private:
+	uint32_t id = 0;
+
+public:
+	istr() = default;
+	explicit istr(const std::string_view str) : id(StrArena::intern(str)) {}
+
+	// 常量用, 不会被回收, 可长期保存用于比较
+	static istr pinned(const std::string_view str) {
+		istr res;
+		res.id = StrArena::intern(str, true);
+		return res;
+	}
+
+	// 只查找, 不入池, 不存在返回空串
+	static istr find(const std::string_view str) {
+		istr res;
+		res.id = StrArena::find(str);
+		return res;
+	}
+
+	istr& operator=(const std::string_view str) {
+		id = StrArena::intern(str);
+		return *this;
+	}
+
+	uint32_t getId() const { return id; }
+	bool empty() const { return id == 0; }
+	size_t length() const { return id ? StrArena::entryAt(id).len : 0; }
+	const char* c_str() const { return id ? StrArena::entryAt(id).ptr.load(std::memory_order_acquire) : ""; }
+	std::string_view view() const { return StrArena::view(id); }
+	operator std::string_view() const { return view(); }
+
+	bool operator==(const istr& other) const { return id == other.id; }
+	bool operator==(const std::string_view str) const { return view() == str; }
+};
+
+inline std::string operator+(const istr& lhs, const std::string_view rhs) {
+	std::string res;
+	res.reserve(lhs.length() + rhs.length());
+	res.append(lhs.view()).append(rhs);
+	return res;
+}
+
+inline std::string operator+(const std::string_view lhs, const istr& rhs) {
+	std::string res;
+	res.reserve(lhs.length() + rhs.length());
+	res.append(lhs).append(rhs.view());
+	return res;
+}
+
+template<>
+struct std::hash<istr> {
+	size_t operator()(const istr& str) const noexcept { return str.getId(); }
+};
+
+namespace StrArena {
+	// markLive(mark): 持有者对每个仍在使用的 istr 调用 mark(str)
+	// 只在应用表的持有者(持有应用表锁)调用, 其他线程只读存活的编号
+	// 待回收的不多时不做任何事, 返回是否搬迁
+	template<typename F>
+	bool collect(F&& markLive) {
+		std::lock_guard<std::mutex> lock(arenaMutex);
+
+		std::vector<bool> isLive(entryCnt);
+		markLive([&](const istr& str) { isLive[str.getId()] = true; });
+
+		size_t liveBytes = 0, deadBytes = 0;
+		for (uint32_t id = 1; id < entryCnt; id++) {
+			entry& e = entryAt(id);
+			if (!e.isUsed) continue;
+			if (e.isPinned) isLive[id] = true;
+			(isLive[id] ? liveBytes : deadBytes) += e.len + 1;
+		}
+		if (deadBytes < COLLECT_MIN_BYTES || deadBytes * 4 < liveBytes) return false;
+
+		for (auto& b : blocks) retiredBlocks.emplace_back(std::move(b));
+		retiredBytes += blockBytes;
+		retireTime = time(nullptr);
+		blocks.clear();
+		blockUsed = blockBytes = contentBytes = 0;
+
+		for (uint32_t id = 1; id < entryCnt; id++) {
+			entry& e = entryAt(id);
+			if (!e.isUsed) continue;
+			if (isLive[id]) {
+				e.ptr.store(store({ e.ptr.load(std::memory_order_relaxed), e.len }), std::memory_order_release);
+			}
+			else {
+				e.isUsed = false; // ptr 仍指向旧内存块, 迟到的读取到期前仍有效
+				retiredIds.emplace_back(id);
+				usedCnt--;
+			}
+		}
+		rehash(usedCnt);
+		collectCnt++;
+		return true;
+	}
+}
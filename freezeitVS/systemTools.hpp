@@ -3,6 +3,7 @@
 #include "utils.hpp"
 #include "settings.hpp"
 #include "freezeit.hpp"
+#include "bufferPool.hpp"
 
 class SystemTools {
 private:
@@ -67,6 +68,14 @@ public:
 	bool isAudioPlaying = false;
 	// bool isMicrophoneRecording = false;
 
+	// 自身开销统计 每10分钟采样一次, 用于计算近期开销
+	constexpr static int SELF_COST_INTERVAL = 600;
+	mutex selfCostMutex;
+	time_t lastSelfCostTime = 0;
+	int lastSelfCostInterval = 0;
+	vector<threadCostStruct> lastSelfCost, lastSelfCostDelta;
+	uint64_t lastChildrenCpuMs = 0, lastChildrenCpuDeltaMs = 0;
+
 
 	SystemTools& operator=(SystemTools&&) = delete;
 
@@ -122,6 +131,28 @@ public:
 		return 4L * 23;
 	}
 
+	// 紧凑格式 由客户端自行绘图, 约2.4KB, 替代约4MiB的位图
+	// int[4]: [采样数32, 每采样项数9, cpuCluster, cpuCoreAll]
+	// + cpuRealTimeStruct[32][9] 从旧到新, 每采样 [0-7]各核心 [8]总使用率
+	// + formatRealTime() 92字节
+	size_t formatRealTimeSeries(int* ptr) {
+		int i = 0;
+		ptr[i++] = maxBucketSize;
+		ptr[i++] = 9;
+		ptr[i++] = cpuCluster;
+		ptr[i++] = cpuCoreAll;
+
+		for (int bucket = 1; bucket <= maxBucketSize; bucket++) {
+			const auto& sample = cpuRealTime[(cpuBucketIdx + bucket) & 0x1f];
+			for (int coreIdx = 0; coreIdx < 9; coreIdx++) {
+				ptr[i++] = sample[coreIdx].freq;
+				ptr[i++] = sample[coreIdx].usage;
+			}
+		}
+
+		return 4L * i + formatRealTime(ptr + i);
+	}
+
 	uint32_t getExtMemorySize() {
 		const char* filePathMIUI = "/data/extm/extm_file";
 		const char* filePathCOS = "/data/nandswap/swapfile";
@@ -252,7 +283,7 @@ public:
 		static int lastCapacity = 0;
 		static int lastMinute = 0;
 
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
 		if (settings.enableBatteryMonitor == 0 || (++secCnt < TIMEOUT))
 			return;
@@ -296,25 +327,13 @@ public:
 			const int nowMinute = static_cast<int>(time(nullptr) / 60);
 			const int deltaMinute = nowMinute - lastMinute;
 
-			char timeStr[64]{ 0 };
-			size_t len = 0;
-			if (deltaMinute >= 60)
-				STRNCAT(timeStr, len, "%d时", deltaMinute / 60);
-			STRNCAT(timeStr, len, "%d分钟", deltaMinute % 60);
-
 			const int temperature = Utils::readInt("/sys/class/power_supply/battery/temp");
-			freezeit.log("%s到 %d%%  %s%s了%d%%  %.2fw %.1f℃",
-				lastCapacity > nowCapacity ?
-				(deltaMinute == 1 ? "❗耗电" : "🔋放电") :
-				(mWatt > 20'000 ? "⚡快充" : "🔌充电"),
-				nowCapacity, timeStr, lastCapacity > nowCapacity ? "用" : "充",
-				abs(lastCapacity - nowCapacity),
-				mWatt / 1e3, temperature / 1e1);
+			freezeit.event(EVENT::BATTERY, lastCapacity, nowCapacity, deltaMinute * 60, mWatt,
+				temperature);
 
 			lastMinute = nowMinute;
 			lastCapacity = nowCapacity;
 		}
-		END_TIME_COUNT;
 	}
 
 
@@ -431,30 +450,29 @@ public:
 		}
 	}
 
-	uint32_t drawChart(uint32_t* imgBuf, uint32_t height, uint32_t width) {
-		START_TIME_COUNT;
-
+	// 图表最多 1M 像素, 超出则长宽减半
+	static uint32_t chartImgSize(uint32_t& height, uint32_t& width) {
 		while (height * width > 1024 * 1024) {
 			height /= 2;
 			width /= 2;
 		}
+		return sizeof(uint32_t) * height * width;
+	}
 
-		const uint32_t imgSize = sizeof(uint32_t) * height * width;
-		memset(imgBuf, 0, imgSize);
+	uint32_t drawChart(uint32_t* imgBuf, uint32_t height, uint32_t width) {
+		TRACE_SCOPE;
+
+		const uint32_t imgSize = chartImgSize(height, width);
 		const uint32_t imgHeight = height * 4 / 5; // 0.8;
 
 		// ABGR
 		constexpr uint32_t COLOR_BLUE = 0xBBFF8000;
 		constexpr uint32_t COLOR_GRAY = 0x01808080;
 
-		const uint32_t percent25 = (height / 5) * width;
-		const uint32_t percent50 = (height * 2 / 5) * width;
-		const uint32_t percent75 = (height * 3 / 5) * width;
-		for (uint32_t x = 0; x < width; x++) { //横线
-			imgBuf[percent25 + x] = COLOR_GRAY;
-			imgBuf[percent50 + x] = COLOR_GRAY;
-			imgBuf[percent75 + x] = COLOR_GRAY;
-		}
+		memset(imgBuf, 0, imgSize);
+		fillSpan(imgBuf + (height / 5) * width, COLOR_GRAY, width); //横线
+		fillSpan(imgBuf + (height * 2 / 5) * width, COLOR_GRAY, width);
+		fillSpan(imgBuf + (height * 3 / 5) * width, COLOR_GRAY, width);
 
 		uint32_t line_x_pos[10]{ 0 };
 		for (int i = 1; i < 10; ++i)
@@ -480,21 +498,16 @@ public:
 				width * 95 / 100,
 		};
 
-		//内存 进度条
-		if (memInfo.totalSwap == 0) { // 0.85
-			for (uint32_t y = (height * 218) >> 8; y < height; y++) {
-				const uint32_t heightBase = width * y;
-				for (uint32_t x = mem_x_pos[0]; x < mem_x_pos[2]; x++)
-					imgBuf[heightBase + x] = x < mem_x_pos[1] ? COLOR_BLUE : COLOR_GRAY;
-			}
-		}
-		else {
-			for (uint32_t y = (height * 218) >> 8; y < height; y++) {
-				const uint32_t heightBase = width * y;
-				for (uint32_t x = mem_x_pos[0]; x < mem_x_pos[2]; x++)
-					imgBuf[heightBase + x] = x < mem_x_pos[1] ? COLOR_BLUE : COLOR_GRAY;
-				for (uint32_t x = mem_x_pos[3]; x < mem_x_pos[5]; x++)
-					imgBuf[heightBase + x] = x < mem_x_pos[4] ? COLOR_BLUE : COLOR_GRAY;
+		//内存 进度条 0.85
+		const int barCnt = memInfo.totalSwap == 0 ? 1 : 2;
+		for (uint32_t y = (height * 218) >> 8; y < height; y++) {
+			uint32_t* row = imgBuf + width * y;
+			for (int barIdx = 0; barIdx < barCnt; barIdx++) {
+				const uint32_t begin = mem_x_pos[barIdx * 3];
+				const uint32_t end = mem_x_pos[barIdx * 3 + 2];
+				const uint32_t used = std::clamp(mem_x_pos[barIdx * 3 + 1], begin, end);
+				fillSpan(row + begin, COLOR_BLUE, used - begin);
+				fillSpan(row + used, COLOR_GRAY, end - used);
 			}
 		}
 
@@ -513,68 +526,70 @@ public:
 				if (y1 <= 0) y1 = 1;
 				else if (y1 >= imgHeight) y1 = imgHeight - 1;
 
-				drawLine(imgBuf, width, COLOR_CPU[coreIdx], (width * (minuteIdx - 1)) / 31, y0,
-					(width * minuteIdx) / 31, y1);
+				drawSegment(imgBuf, width, COLOR_CPU[coreIdx], (width * (minuteIdx - 1)) / 31, y0,
+					std::min((width * minuteIdx) / 31, width - 1), y1);
 			}
 		}
 
 		const uint32_t bottomLine = imgHeight * width;
-		for (uint32_t x = 0; x < width; x++) { //上下横线
-			imgBuf[x] = COLOR_BLUE;
-			imgBuf[bottomLine + x] = COLOR_BLUE;
-		}
+		fillSpan(imgBuf, COLOR_BLUE, width); //上下横线
+		fillSpan(imgBuf + bottomLine, COLOR_BLUE, width);
 
 		for (uint32_t y = 0; y < imgHeight; y++) { //两侧竖线
 			imgBuf[width * y] = COLOR_BLUE;
 			imgBuf[width * (y + 1) - 1] = COLOR_BLUE;
 		}
 
-		END_TIME_COUNT;
 		return imgSize;
 	}
 
-	// https://rosettacode.org/wiki/Bitmap/Bresenham%27s_line_algorithm#C
-	// Bresenham s_line_algorithm
-	void drawLine(uint32_t*& imgBuf, const uint32_t width, const uint32_t COLOR,
-		int x0, int y0, const int x1, const int y1) {
-
-		//delta x y,  step x y
-		const int dx = abs(x1 - x0);
-		const int dy = abs(y1 - y0);
-		const int sx = x0 < x1 ? 1 : -1;
-		const int sy = y0 < y1 ? 1 : -1;
-		int err = (dx > dy ? dx : -dy) / 2, e2;
-
-		while (true) {
-			if (y0 == y1) {
-				int minValue = x0 <= x1 ? x0 : x1;
-				const int maxValue = x0 > x1 ? x0 : x1;
-				for (; minValue <= maxValue; minValue++)
-					imgBuf[width * y0 + minValue] = COLOR;
-				return;
-			}
-			else if (x0 == x1) {
-				int minValue = y0 <= y1 ? y0 : y1;
-				const int maxValue = y0 > y1 ? y0 : y1;
-				for (; minValue <= maxValue; minValue++)
-					imgBuf[width * minValue + x0] = COLOR;
-				return;
-			}
-
-			imgBuf[width * y0 + x0] = COLOR;
+	// 按列扫描绘制线段 (x0 <= x1): 每列填充线段在该列内覆盖的纵向区段, 水平段整行填充
+	static void drawSegment(uint32_t* imgBuf, const uint32_t width, const uint32_t color,
+		const int x0, const int y0, const int x1, const int y1) {
+		const int dx = x1 - x0;
+		const int dy = y1 - y0;
+		if (dy == 0) {
+			fillSpan(imgBuf + width * y0 + x0, color, dx + 1);
+			return;
+		}
 
-			e2 = err;
-			if (e2 > -dx) {
-				err -= dy;
-				x0 += sx;
-			}
-			if (e2 < dy) {
-				err += dx;
-				y0 += sy;
-			}
+		int yPrev = y0;
+		for (int x = x0; x <= x1; x++) {
+			// 本列右边缘 x+0.5 处的纵坐标
+			const int yNext = (x == x1) ? y1 : y0 + dy * (2 * (x - x0) + 1) / (2 * dx);
+			const int yBegin = std::min(yPrev, yNext);
+			const int yEnd = std::max(yPrev, yNext);
+			uint32_t* ptr = imgBuf + width * yBegin + x;
+			for (int y = yBegin; y <= yEnd; y++, ptr += width)
+				*ptr = color;
+			yPrev = yNext;
 		}
 	}
 
+	// 区段填充 每次写4像素 (NEON / SSE2), 不支持的平台逐个写入
+	static void fillSpan(uint32_t* dst, const uint32_t color, size_t cnt) {
+#if defined(__ARM_NEON)
+		const uint32x4_t colorVec = vdupq_n_u32(color);
+		for (; cnt >= 4; cnt -= 4, dst += 4)
+			vst1q_u32(dst, colorVec);
+#elif defined(__SSE2__)
+		const __m128i colorVec = _mm_set1_epi32(static_cast<int>(color));
+		for (; cnt >= 4; cnt -= 4, dst += 4)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), colorVec);
+#endif
+		for (; cnt; cnt--)
+			*dst++ = color;
+	}
+
+	// 订阅推送时客户端不再逐次提供可用内存, 由 /proc/meminfo MemAvailable 获取
+	static uint32_t readMemAvailableMiB() {
+		char buff[512];
+		if (Utils::readString("/proc/meminfo", buff, sizeof(buff) - 1) == 0) return 0;
+
+		const char* ptr = strstr(buff, "MemAvailable:");
+		return ptr ? static_cast<uint32_t>(strtoul(ptr + 13, nullptr, 10) >> 10) : 0; // KiB -> MiB
+	}
+
 	void getCPU_realtime(uint32_t availableMiB) {
 		static char path[] = "/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq";
 		static uint32_t jiffiesSumLast[9] = {};
@@ -652,27 +667,206 @@ public:
 	}
 
 
+	// 线程名 -> 所属模块
+	static const char* getSubsystem(const char* threadName) {
+		if (!strcmp(threadName, "cpuset")) return "前台触发";
+		if (!strcmp(threadName, "cycle")) return "冻结调度";
+		if (!strcmp(threadName, "snd")) return "音频监控";
+		if (!strcmp(threadName, "pkgwatch")) return "应用管理";
+		if (!strcmp(threadName, "cfgstore")) return "配置存储";
+		if (!strcmp(threadName, "server") || !strcmp(threadName, "worker")) return "通信服务";
+		if (!strcmp(threadName, "freezeit")) return "主线程";
+		return "其他";
+	}
+
+	static vector<threadCostStruct> readThreadCost() {
+		vector<threadCostStruct> res;
+
+		DIR* dir = opendir("/proc/self/task");
+		if (dir == nullptr) return res;
+
+		char path[64], buff[1024 * 4];
+		struct dirent* file;
+		while ((file = readdir(dir)) != nullptr) {
+			if (file->d_name[0] < '0' || file->d_name[0] > '9') continue;
+
+			threadCostStruct cost;
+			cost.tid = atoi(file->d_name);
+
+			snprintf(path, sizeof(path), "/proc/self/task/%d/comm", cost.tid);
+			const size_t nameLen = Utils::readString(path, cost.name, sizeof(cost.name) - 1);
+			if (nameLen && cost.name[nameLen - 1] == '\n')
+				cost.name[nameLen - 1] = 0;
+
+			snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", cost.tid);
+			if (Utils::readString(path, buff, sizeof(buff) - 1)) {
+				unsigned long long runNs = 0, waitNs = 0, runCnt = 0;
+				sscanf(buff, "%llu %llu %llu", &runNs, &waitNs, &runCnt);
+				cost.cpuNs = runNs;
+				cost.runCnt = runCnt;
+			}
+
+			// 切换次数在 status 末尾, 读满缓冲区时可能被截断, 改为完整读取
+			snprintf(path, sizeof(path), "/proc/self/task/%d/status", cost.tid);
+			const size_t statusLen = Utils::readString(path, buff, sizeof(buff) - 1);
+			string status;
+			const char* statusPtr = buff;
+			if (statusLen == sizeof(buff) - 1) {
+				status = Utils::readString(path);
+				statusPtr = status.c_str();
+			}
+			if (statusLen) {
+				auto ptr = strstr(statusPtr, "voluntary_ctxt_switches:");
+				if (ptr) cost.volCtxSw = strtoull(ptr + 24, nullptr, 10);
+				ptr = strstr(statusPtr, "nonvoluntary_ctxt_switches:");
+				if (ptr) cost.involCtxSw = strtoull(ptr + 27, nullptr, 10);
+			}
+
+			res.emplace_back(cost);
+		}
+		closedir(dir);
+		return res;
+	}
+
+	// 已回收子进程(dumpsys等命令)的CPU时间 /proc/self/stat 第16,17项 cutime cstime
+	static uint64_t readChildrenCpuMs() {
+		char buff[1024];
+		if (Utils::readString("/proc/self/stat", buff, sizeof(buff) - 1) == 0) return 0;
+
+		auto ptr = strrchr(buff, ')');
+		if (!ptr) return 0;
+
+		unsigned long cutime = 0, cstime = 0;
+		if (sscanf(ptr + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %lu %lu",
+			&cutime, &cstime) != 2)
+			return 0;
+		return (cutime + cstime) * 1000ULL / sysconf(_SC_CLK_TCK);
+	}
+
+	// call once per 1sec, 内部每10分钟采样一次
+	void sampleSelfCost() {
+		const time_t now = time(nullptr);
+		if ((now - lastSelfCostTime) < SELF_COST_INTERVAL) return;
+
+		auto cur = readThreadCost();
+		const uint64_t childrenCpuMs = readChildrenCpuMs();
+
+		lock_guard<mutex> lock(selfCostMutex);
+		if (lastSelfCostTime) {
+			lastSelfCostDelta.clear();
+			for (const auto& it : cur) {
+				threadCostStruct delta = it;
+				for (const auto& last : lastSelfCost) {
+					if (last.tid != it.tid) continue;
+					delta.cpuNs -= last.cpuNs;
+					delta.runCnt -= last.runCnt;
+					delta.volCtxSw -= last.volCtxSw;
+					delta.involCtxSw -= last.involCtxSw;
+					break;
+				}
+				lastSelfCostDelta.emplace_back(delta);
+			}
+			lastSelfCostInterval = now - lastSelfCostTime;
+			lastChildrenCpuDeltaMs = childrenCpuMs - lastChildrenCpuMs;
+		}
+		lastSelfCost = move(cur);
+		lastChildrenCpuMs = childrenCpuMs;
+		lastSelfCostTime = now;
+	}
+
+	// 进程RSS (/proc/self/status) 与各模块缓冲区占用
+	size_t formatMemStats(char* buf, const size_t maxLen) {
+		const string status = Utils::readString("/proc/self/status");
+		size_t len = snprintf(buf, maxLen, "进程内存\n");
+		for (const char* key : { "VmRSS:", "VmHWM:", "RssAnon:", "RssFile:", "VmStk:", "Threads:" }) {
+			const size_t idx = status.find(key);
+			if (idx == string::npos) continue;
+			const size_t end = status.find('\n', idx);
+			len += snprintf(buf + len, maxLen - len, "  %s\n", status.substr(idx, end - idx).c_str());
+			if (len >= maxLen) return maxLen;
+		}
+
+		len += BufferPool::formatStats(buf + len, maxLen - len);
+		if (len >= maxLen) return maxLen;
+		len += StrArena::formatStats(buf + len, maxLen - len);
+		if (len >= maxLen) return maxLen;
+
+		const auto spanRing = Trace::spanRing.load(std::memory_order_acquire);
+		len += snprintf(buf + len, maxLen - len, "常驻缓冲\n  日志 %zu KiB\n  耗时片段 %zu KiB%s\n",
+			freezeit.getLogMemSize() >> 10, spanRing ? (Trace::RING_SIZE * sizeof(Trace::spanRecord)) >> 10 : 0,
+			spanRing ? "" : " (未开启)");
+		return std::min(len, maxLen);
+	}
+
+	size_t formatSelfCost(char* buf, const size_t maxLen) {
+		const auto cur = readThreadCost();
+		const uint64_t childrenCpuMs = readChildrenCpuMs();
+
+		lock_guard<mutex> lock(selfCostMutex);
+
+		size_t len = snprintf(buf, maxLen, "线程累计开销\n%-7s %-10s %-10s %10s %10s %10s %10s\n",
+			"TID", "线程", "模块", "CPU(ms)", "调度次数", "唤醒次数", "被抢占");
+		map<string, threadCostStruct> subsystemCost;
+		for (const auto& it : cur) {
+			if (len + 256 >= maxLen) break;
+			len += snprintf(buf + len, maxLen - len, "%-7d %-10s %-10s %10.1f %10llu %10llu %10llu\n",
+				it.tid, it.name, getSubsystem(it.name), it.cpuNs / 1e6, (unsigned long long)it.runCnt,
+				(unsigned long long)it.volCtxSw, (unsigned long long)it.involCtxSw);
+
+			auto& sum = subsystemCost[getSubsystem(it.name)];
+			sum.cpuNs += it.cpuNs;
+			sum.runCnt += it.runCnt;
+			sum.volCtxSw += it.volCtxSw;
+			sum.involCtxSw += it.involCtxSw;
+		}
+
+		len += snprintf(buf + len, maxLen - len, "\n模块累计开销\n");
+		for (const auto& [name, it] : subsystemCost) {
+			if (len + 256 >= maxLen) break;
+			len += snprintf(buf + len, maxLen - len, "%-10s CPU %.1fms 唤醒 %llu 次\n", name.c_str(),
+				it.cpuNs / 1e6, (unsigned long long)it.volCtxSw);
+		}
+		len += snprintf(buf + len, maxLen - len, "子进程(命令行工具) CPU %llums\n",
+			(unsigned long long)childrenCpuMs);
+
+		if (lastSelfCostInterval > 0 && len + 256 < maxLen) {
+			subsystemCost.clear();
+			for (const auto& it : lastSelfCostDelta) {
+				auto& sum = subsystemCost[getSubsystem(it.name)];
+				sum.cpuNs += it.cpuNs;
+				sum.volCtxSw += it.volCtxSw;
+			}
+
+			len += snprintf(buf + len, maxLen - len, "\n近 %d 分钟模块开销\n", lastSelfCostInterval / 60);
+			for (const auto& [name, it] : subsystemCost) {
+				if (len + 256 >= maxLen) break;
+				len += snprintf(buf + len, maxLen - len, "%-10s CPU %.1fms 唤醒 %.2f 次/分钟\n",
+					name.c_str(), it.cpuNs / 1e6, it.volCtxSw * 60.0 / lastSelfCostInterval);
+			}
+			len += snprintf(buf + len, maxLen - len, "子进程(命令行工具) CPU %llums\n",
+				(unsigned long long)lastChildrenCpuDeltaMs);
+		}
+		return std::min(len, maxLen);
+	}
+
 	// 0获取失败 1失败 2成功
 	int breakNetworkByLocalSocket(int uid) {
-		START_TIME_COUNT;
+		TRACE_SCOPE;
 
 		int buff[64];
 		const int recvLen = Utils::localSocketRequest(XPOSED_CMD::BREAK_NETWORK, &uid, 4, buff,
 			sizeof(buff));
 
 		if (recvLen == 0) {
-			freezeit.log("%s() 工作异常, 请确认LSPosed中冻它勾选系统框架, 然后重启", __FUNCTION__);
-			END_TIME_COUNT;
+			LOG_LIMIT(60, "%s() 工作异常, 请确认LSPosed中冻它勾选系统框架, 然后重启", __FUNCTION__);
 			return 0;
 		}
 		else if (recvLen != 4) {
 			freezeit.log("%s() 返回数据异常 recvLen[%d]", __FUNCTION__, recvLen);
 			if (recvLen > 0 && recvLen < 64 * 4)
 				freezeit.log("DumpHex: %s", Utils::bin2Hex(buff, recvLen).c_str());
-			END_TIME_COUNT;
 			return 0;
 		}
-		END_TIME_COUNT;
 		return buff[0];
 	}
 
@@ -683,6 +877,8 @@ public:
 		const int SND_BUF_SIZE = 8192;
 		const char* sndPath = "/dev/snd";
 
+		Trace::setThreadName("snd");
+
 		// const char *event_str[EVENT_NUM] =
 		// {
 		//     "IN_ACCESS",
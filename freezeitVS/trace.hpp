@@ -0,0 +1,290 @@
+#pragma once
+
+#include "utils.hpp"
+
+// 函数耗时统计: TRACE_SCOPE 记录所在作用域的 CLOCK_MONOTONIC 耗时到该位置专属的直方图
+// 运行时由设置项开关, 关闭时每次调用只有一次原子读取
+// 开启时同时把每个片段写入环形缓冲区, 可导出为 Chrome trace-event JSON (Perfetto / chrome://tracing)
+// 片段时间戳使用 CLOCK_BOOTTIME, 与 Perfetto 抓取的系统 trace 同一时钟
+namespace Trace {
+
+	inline atomic<bool> enabled{ false };
+
+	// 对数直方图: 每个2的幂区间再分4个子桶, 相对误差不超过25%
+	constexpr int BUCKET_CNT = 256;
+
+	constexpr int bucketIdx(const uint64_t ns) {
+		if (ns < 4) return static_cast<int>(ns);
+		const int exp = 63 - __builtin_clzll(ns);
+		const int sub = static_cast<int>((ns >> (exp - 2)) & 3);
+		return (exp - 1) * 4 + sub;
+	}
+
+	// 桶的上界 ns
+	constexpr uint64_t bucketUpper(const int idx) {
+		if (idx < 4) return idx + 1;
+		const int exp = idx / 4 + 1;
+		return (static_cast<uint64_t>(4 + idx % 4 + 1)) << (exp - 2);
+	}
+
+	struct spanStat {
+		const char* name;
+		spanStat* next = nullptr;
+		atomic<uint64_t> count{ 0 };
+		atomic<uint64_t> sumNs{ 0 };
+		atomic<uint64_t> maxNs{ 0 };
+		atomic<uint32_t> bucket[BUCKET_CNT]{};
+
+		explicit spanStat(const char* _name);
+
+		void record(const uint64_t ns) {
+			count.fetch_add(1, std::memory_order_relaxed);
+			sumNs.fetch_add(ns, std::memory_order_relaxed);
+			bucket[bucketIdx(ns)].fetch_add(1, std::memory_order_relaxed);
+
+			uint64_t lastMax = maxNs.load(std::memory_order_relaxed);
+			while (ns > lastMax && !maxNs.compare_exchange_weak(lastMax, ns, std::memory_order_relaxed));
+		}
+
+		// ratio: 0.5 -> p50, 0.99 -> p99
+		uint64_t percentile(const double ratio) const {
+			const uint64_t cnt = count.load(std::memory_order_relaxed);
+			if (cnt == 0) return 0;
+
+			const uint64_t target = static_cast<uint64_t>(ceil(cnt * ratio));
+			uint64_t sum = 0;
+			for (int i = 0; i < BUCKET_CNT; i++) {
+				sum += bucket[i].load(std::memory_order_relaxed);
+				if (sum >= target)
+					return std::min(bucketUpper(i), maxNs.load(std::memory_order_relaxed));
+			}
+			return maxNs.load(std::memory_order_relaxed);
+		}
+
+		void reset() {
+			count.store(0, std::memory_order_relaxed);
+			sumNs.store(0, std::memory_order_relaxed);
+			maxNs.store(0, std::memory_order_relaxed);
+			for (auto& it : bucket)
+				it.store(0, std::memory_order_relaxed);
+		}
+	};
+
+	// 所有统计项组成的单向链表, 只增不删
+	inline atomic<spanStat*> statList{ nullptr };
+
+	inline spanStat::spanStat(const char* _name) : name(_name) {
+		next = statList.load(std::memory_order_relaxed);
+		while (!statList.compare_exchange_weak(next, this, std::memory_order_release,
+			std::memory_order_relaxed));
+	}
+
+	inline uint64_t nowNs() {
+		timespec ts{};
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1'000'000'000ULL + ts.tv_nsec;
+	}
+
+	inline uint64_t bootNs() {
+		timespec ts{};
+		clock_gettime(CLOCK_BOOTTIME, &ts);
+		return ts.tv_sec * 1'000'000'000ULL + ts.tv_nsec;
+	}
+
+	inline int currentTid() {
+		static thread_local const int tid = gettid();
+		return tid;
+	}
+
+	// 线程名称登记, 用于导出时标注线程
+	constexpr int THREAD_MAX = 16;
+	inline atomic<int> threadCnt{ 0 };
+	inline atomic<int> threadTid[THREAD_MAX]{};
+	inline const char* threadName[THREAD_MAX]{};
+
+	// 同时设置内核线程名(最长15字节), 可在 /proc/self/task/*/comm 看到
+	inline void setThreadName(const char* name) {
+		prctl(PR_SET_NAME, name);
+
+		const int idx = threadCnt.fetch_add(1, std::memory_order_relaxed);
+		if (idx >= THREAD_MAX) return;
+		threadName[idx] = name;
+		threadTid[idx].store(currentTid(), std::memory_order_release);
+	}
+
+	// 片段环形缓冲区, 首次开启时分配, 之后不再释放
+	// 每个槽位以 seq 作为版本号: 写入中为0, 写完为 序号+1, 读取前后 seq 一致才有效
+	constexpr uint64_t RING_SIZE = 8192; // 须为2的幂
+	constexpr uint64_t INSTANT_SPAN = ~0ULL; // durNs 为此值表示瞬时事件
+
+	struct spanRecord {
+		atomic<uint64_t> seq{ 0 };
+		atomic<const char*> name{ nullptr };
+		atomic<uint64_t> startNs{ 0 };
+		atomic<uint64_t> durNs{ 0 };
+		atomic<int> tid{ 0 };
+		atomic<int> arg{ 0 };
+	};
+
+	inline atomic<spanRecord*> spanRing{ nullptr };
+	inline atomic<uint64_t> spanRingIdx{ 0 };
+
+	inline void pushSpan(const char* name, const uint64_t startNs, const uint64_t durNs, const int arg) {
+		auto ring = spanRing.load(std::memory_order_acquire);
+		if (!ring) return;
+
+		const uint64_t idx = spanRingIdx.fetch_add(1, std::memory_order_relaxed);
+		auto& rec = ring[idx & (RING_SIZE - 1)];
+		rec.seq.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		rec.name.store(name, std::memory_order_relaxed);
+		rec.startNs.store(startNs, std::memory_order_relaxed);
+		rec.durNs.store(durNs, std::memory_order_relaxed);
+		rec.tid.store(currentTid(), std::memory_order_relaxed);
+		rec.arg.store(arg, std::memory_order_relaxed);
+		rec.seq.store(idx + 1, std::memory_order_release);
+	}
+
+	// 瞬时事件, 如 Doze 进入/退出
+	inline void instant(const char* name, const int arg = 0) {
+		if (enabled.load(std::memory_order_relaxed))
+			pushSpan(name, bootNs(), INSTANT_SPAN, arg);
+	}
+
+	class scopedSpan {
+	private:
+		spanStat* stat;
+		uint64_t startNs;
+		uint64_t startBootNs;
+		int arg;
+
+	public:
+		explicit scopedSpan(spanStat& _stat, const int _arg = 0) : arg(_arg) {
+			if (enabled.load(std::memory_order_relaxed)) {
+				stat = &_stat;
+				startNs = nowNs();
+				startBootNs = bootNs();
+			}
+			else {
+				stat = nullptr;
+				startNs = 0;
+				startBootNs = 0;
+			}
+		}
+
+		~scopedSpan() {
+			if (!stat) return;
+			const uint64_t durNs = nowNs() - startNs;
+			stat->record(durNs);
+			pushSpan(stat->name, startBootNs, durNs, arg);
+		}
+
+		scopedSpan(const scopedSpan&) = delete;
+		scopedSpan& operator=(const scopedSpan&) = delete;
+	};
+
+	inline void setEnable(const bool enable) {
+		if (enable && !spanRing.load(std::memory_order_acquire)) {
+			spanRecord* expected = nullptr;
+			auto ring = new spanRecord[RING_SIZE];
+			if (!spanRing.compare_exchange_strong(expected, ring, std::memory_order_acq_rel))
+				delete[] ring;
+		}
+		enabled.store(enable, std::memory_order_relaxed);
+	}
+
+	inline void resetAll() {
+		for (auto stat = statList.load(std::memory_order_acquire); stat; stat = stat->next)
+			stat->reset();
+	}
+
+	// 文本表格, 按总耗时降序, 时间单位 us
+	inline size_t formatStat(char* buf, const size_t maxLen) {
+		vector<spanStat*> statSort;
+		for (auto stat = statList.load(std::memory_order_acquire); stat; stat = stat->next)
+			if (stat->count.load(std::memory_order_relaxed))
+				statSort.emplace_back(stat);
+
+		std::sort(statSort.begin(), statSort.end(), [](const spanStat* a, const spanStat* b) {
+			return a->sumNs.load(std::memory_order_relaxed) > b->sumNs.load(std::memory_order_relaxed);
+			});
+
+		size_t len = snprintf(buf, maxLen, "%s\n", enabled ? "耗时统计 已开启" : "耗时统计 未开启");
+		len += snprintf(buf + len, maxLen - len, "%-28s %8s %10s %10s %10s\n",
+			"函数", "次数", "p50(us)", "p99(us)", "max(us)");
+		for (const auto stat : statSort) {
+			if (len + 128 >= maxLen) break;
+			len += snprintf(buf + len, maxLen - len, "%-28s %8lu %10.1f %10.1f %10.1f\n",
+				stat->name, (unsigned long)stat->count.load(std::memory_order_relaxed),
+				stat->percentile(0.5) / 1e3, stat->percentile(0.99) / 1e3,
+				stat->maxNs.load(std::memory_order_relaxed) / 1e3);
+		}
+		return len;
+	}
+
+	// 导出环形缓冲区中的片段为 Chrome trace-event JSON, 时间单位 us
+	inline size_t formatJson(char* buf, const size_t maxLen) {
+		const int pid = getpid();
+		size_t len = snprintf(buf, maxLen, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+		bool isFirst = true;
+
+		const int threadNum = std::min(threadCnt.load(std::memory_order_relaxed), THREAD_MAX);
+		for (int i = 0; i < threadNum && len + 256 < maxLen; i++) {
+			const int tid = threadTid[i].load(std::memory_order_acquire);
+			if (tid == 0) continue;
+			len += snprintf(buf + len, maxLen - len,
+				"%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				isFirst ? "" : ",", pid, tid, threadName[i]);
+			isFirst = false;
+		}
+
+		const auto ring = spanRing.load(std::memory_order_acquire);
+		if (ring) {
+			const uint64_t endIdx = spanRingIdx.load(std::memory_order_acquire);
+			const uint64_t startIdx = endIdx > RING_SIZE ? endIdx - RING_SIZE : 0;
+			for (uint64_t idx = startIdx; idx < endIdx && len + 256 < maxLen; idx++) {
+				const auto& rec = ring[idx & (RING_SIZE - 1)];
+				const uint64_t seq = rec.seq.load(std::memory_order_acquire);
+				const char* name = rec.name.load(std::memory_order_relaxed);
+				const uint64_t startNs = rec.startNs.load(std::memory_order_relaxed);
+				const uint64_t durNs = rec.durNs.load(std::memory_order_relaxed);
+				const int tid = rec.tid.load(std::memory_order_relaxed);
+				const int arg = rec.arg.load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (seq != idx + 1 || rec.seq.load(std::memory_order_relaxed) != seq || !name)
+					continue; // 正在写入或已被覆盖
+
+				len += snprintf(buf + len, maxLen - len,
+					"%s\n{\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%lu.%03lu,", isFirst ? "" : ",",
+					name, pid, tid, (unsigned long)(startNs / 1000), (unsigned long)(startNs % 1000));
+				if (durNs == INSTANT_SPAN)
+					len += snprintf(buf + len, maxLen - len, "\"ph\":\"i\",\"s\":\"t\"");
+				else
+					len += snprintf(buf + len, maxLen - len, "\"ph\":\"X\",\"dur\":%lu.%03lu",
+						(unsigned long)(durNs / 1000), (unsigned long)(durNs % 1000));
+				if (arg)
+					len += snprintf(buf + len, maxLen - len, ",\"args\":{\"arg\":%d}}", arg);
+				else
+					len += snprintf(buf + len, maxLen - len, "}");
+				isFirst = false;
+			}
+		}
+
+		len += snprintf(buf + len, maxLen - len, "\n]}\n");
+		return std::min(len, maxLen);
+	}
+}
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#define TRACE_SCOPE_NAMED(name) \
+	static Trace::spanStat TRACE_CONCAT(traceStat_, __LINE__)(name); \
+	Trace::scopedSpan TRACE_CONCAT(traceSpan_, __LINE__)(TRACE_CONCAT(traceStat_, __LINE__))
+
+#define TRACE_SCOPE TRACE_SCOPE_NAMED(__FUNCTION__)
+
+// 附带一个整数参数, 如命令号/UID, 导出时显示在 args 中
+#define TRACE_SCOPE_ARG(name, arg) \
+	static Trace::spanStat TRACE_CONCAT(traceStat_, __LINE__)(name); \
+	Trace::scopedSpan TRACE_CONCAT(traceSpan_, __LINE__)(TRACE_CONCAT(traceStat_, __LINE__), arg)
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "utils.hpp"
+
+// 以UID为键的表, 接口与迭代顺序同 map<int, T>
+// 应用UID集中在 [UID_BEGIN, UID_END), 由下标数组直接定位槽位: 一次边界检查加一次读取
+// 范围外的UID(极少)存放于 overflow
+// 槽位存于 deque, 插入不移动已有元素, 元素的引用在删除前一直有效, 可作稳定句柄保存
+template<typename T>
+class UidTable {
+public:
+	constexpr static int UID_BEGIN = 10000;
+	constexpr static int UID_END = 12000;
+	constexpr static int UID_SPAN = UID_END - UID_BEGIN;
+
+	using value_type = std::pair<const int, T>;
+
+private:
+	uint16_t slotIdx[UID_SPAN]{}; // 槽位下标+1, 0:不存在
+	deque<std::optional<value_type>> slots;
+	vector<uint16_t> freeSlots;
+	map<int, T> overflow;
+	size_t denseCnt = 0;
+
+	static bool inRange(const int uid) {
+		return static_cast<unsigned>(uid - UID_BEGIN) < static_cast<unsigned>(UID_SPAN);
+	}
+
+	value_type& slotAt(const int pos) { return *slots[slotIdx[pos] - 1]; }
+
+public:
+	// 先遍历 overflow 中小于 UID_BEGIN 的, 再遍历下标数组, 最后是 overflow 其余部分, 整体按UID升序
+	class iterator {
+	private:
+		friend class UidTable;
+		UidTable* table = nullptr;
+		int pos = 0; // -1: overflow低段, [0, UID_SPAN): 下标数组, UID_SPAN: overflow高段
+		typename map<int, T>::iterator ovIt;
+
+		iterator(UidTable* _table, const int _pos, typename map<int, T>::iterator _ovIt) :
+			table(_table), pos(_pos), ovIt(_ovIt) {}
+
+		// 跳过空槽位, 低段结束后进入下标数组, 下标数组结束后进入高段
+		void settle() {
+			if (pos == -1) {
+				if (ovIt != table->overflow.end() && ovIt->first < UID_BEGIN) return;
+				pos = 0;
+			}
+			while (pos < UID_SPAN && table->slotIdx[pos] == 0) pos++;
+			if (pos == UID_SPAN)
+				ovIt = table->overflow.lower_bound(UID_BEGIN);
+		}
+
+	public:
+		iterator() = default;
+
+		value_type& operator*() const { return (0 <= pos && pos < UID_SPAN) ? table->slotAt(pos) : *ovIt; }
+		value_type* operator->() const { return &operator*(); }
+
+		iterator& operator++() {
+			if (0 <= pos && pos < UID_SPAN) {
+				pos++;
+				settle();
+			}
+			else if (pos == -1) {
+				ovIt++;
+				settle();
+			}
+			else ovIt++;
+			return *this;
+		}
+
+		iterator operator++(int) {
+			iterator old = *this;
+			++*this;
+			return old;
+		}
+
+		bool operator==(const iterator& other) const {
+			return pos == other.pos && ((0 <= pos && pos < UID_SPAN) || ovIt == other.ovIt);
+		}
+	};
+
+	iterator begin() {
+		iterator it(this, -1, overflow.begin());
+		it.settle();
+		return it;
+	}
+
+	iterator end() { return iterator(this, UID_SPAN, overflow.end()); }
+
+	iterator find(const int uid) {
+		if (inRange(uid))
+			return slotIdx[uid - UID_BEGIN] ? iterator(this, uid - UID_BEGIN, overflow.end()) : end();
+
+		auto ovIt = overflow.find(uid);
+		return ovIt == overflow.end() ? end() : iterator(this, uid < UID_BEGIN ? -1 : UID_SPAN, ovIt);
+	}
+
+	bool contains(const int uid) const {
+		return inRange(uid) ? slotIdx[uid - UID_BEGIN] != 0 : overflow.contains(uid);
+	}
+
+	T& operator[](const int uid) {
+		if (!inRange(uid)) return overflow[uid];
+
+		auto& idx = slotIdx[uid - UID_BEGIN];
+		if (idx == 0) {
+			if (freeSlots.empty()) {
+				slots.emplace_back();
+				idx = static_cast<uint16_t>(slots.size());
+			}
+			else {
+				idx = freeSlots.back();
+				freeSlots.pop_back();
+			}
+			slots[idx - 1].emplace(uid, T{});
+			denseCnt++;
+		}
+		return slots[idx - 1]->second;
+	}
+
+	// 返回下一个元素
+	iterator erase(iterator it) {
+		iterator next = it;
+		++next;
+		if (0 <= it.pos && it.pos < UID_SPAN) {
+			auto& idx = slotIdx[it.pos];
+			slots[idx - 1].reset();
+			freeSlots.emplace_back(idx);
+			idx = 0;
+			denseCnt--;
+		}
+		else overflow.erase(it.ovIt);
+		return next;
+	}
+
+	size_t erase(const int uid) {
+		auto it = find(uid);
+		if (it == end()) return 0;
+		erase(it);
+		return 1;
+	}
+
+	size_t size() const { return denseCnt + overflow.size(); }
+
+	void clear() {
+		memset(slotIdx, 0, sizeof(slotIdx));
+		slots.clear();
+		freeSlots.clear();
+		overflow.clear();
+		denseCnt = 0;
+	}
+};
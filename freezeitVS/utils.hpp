@@ -13,6 +13,12 @@
 #include <set>
 #include <unordered_set>
 #include <map>
+#include <deque>
+#include <optional>
+#include <array>
+#include <bit>
+#include <string_view>
+#include <condition_variable>
 
 #include <cstdio>
 #include <cerrno>
@@ -23,6 +29,7 @@
 #include <cstdlib>
 #include <csignal>
 #include <cctype>
+#include <climits>
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -42,16 +49,38 @@
 #include <sys/types.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <sys/sysinfo.h>
 #include <sys/utsname.h>
 #include <sys/wait.h>
 #include <sys/prctl.h>
 #include <sys/system_properties.h>
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+#elif defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+#include "strArena.hpp"
+
 using std::set;
 using std::unordered_set;
 using std::map;
+using std::deque;
 using std::multimap;
 using std::stringstream;
 using std::lock_guard;
@@ -62,6 +91,7 @@ using std::string;
 using std::string_view;
 using std::thread;
 using std::mutex;
+using std::atomic;
 
 using std::make_unique;
 using std::to_string;
@@ -72,7 +102,7 @@ using std::move;
 constexpr auto FORK_DOUBLE = 1;
 
 #define DEBUG_LOG            1
-#define DEBUG_DURATION       0
+#define DEBUG_DURATION       0  // 输出调试细节, 函数耗时统计见 trace.hpp
 // *****************************
 
 #if DEBUG_LOG
@@ -81,21 +111,20 @@ constexpr auto FORK_DOUBLE = 1;
 #define DLOG(...) ((void)0)
 #endif
 
-#if DEBUG_DURATION
-#define START_TIME_COUNT auto start_clock = clock()
-#if CLOCKS_PER_SEC == 1000000
-#define END_TIME_COUNT int duration_us=clock()-start_clock;freezeit.log("%s(): %d.%03d ms", __FUNCTION__, duration_us/1000, duration_us%1000)
-#elif CLOCKS_PER_SEC == 1000
-#define END_TIME_COUNT int duration_ms=clock()-start_clock;freezeit.log("%s(): %d ms", __FUNCTION__, duration_ms)
-#else
-#error CLOCKS_PER_SEC value is not support
-#endif
-#else
-#define START_TIME_COUNT ((void)0)
-#define END_TIME_COUNT   ((void)0)
-#endif
+// 追加后更新长度, 截断时 len 停在 bufSize-1 (终止符处), 之后的追加不会越界
+template<typename T>
+inline void strncatAdvance(T& len, const size_t bufSize, const int appendLen) {
+	if (appendLen <= 0) return;
+	const size_t newLen = static_cast<size_t>(len) + appendLen;
+	len = static_cast<T>(newLen < bufSize ? newLen : bufSize - 1);
+}
 
-#define STRNCAT(buf, len, ...) len += snprintf(buf + len, sizeof(buf) - len, __VA_ARGS__)
+#define STRNCAT(buf, len, ...) STRNCAT_N(buf, sizeof(buf), len, __VA_ARGS__)
+#define STRNCAT_N(buf, bufSize, len, ...) strncatAdvance(len, bufSize, snprintf(buf + len, bufSize - len, __VA_ARGS__)) // buf 为指针时使用
+
+// 按调用位置限频的日志, intervalSec 秒内同一位置只输出一次, 期间被抑制的条数在下次输出时附带
+// 调用位置键在编译期计算, 被抑制时不做任何格式化
+#define LOG_LIMIT(intervalSec, ...) freezeit.logLimit<Utils::siteHash(__FILE__, __LINE__)>(intervalSec, __VA_ARGS__)
 
 enum class WORK_MODE : uint32_t {
 	GLOBAL_SIGSTOP = 0,
@@ -142,6 +171,15 @@ struct cpuRealTimeStruct {
 	int usage; // %
 };
 
+struct threadCostStruct {
+	int tid = 0;
+	char name[16]{};
+	uint64_t cpuNs = 0;      // schedstat 运行时间
+	uint64_t runCnt = 0;     // schedstat 被调度上CPU的次数
+	uint64_t volCtxSw = 0;   // 主动让出CPU次数, 即休眠后被唤醒次数
+	uint64_t involCtxSw = 0; // 被抢占次数
+};
+
 struct uidTimeStruct {
 	int lastTotal = 0;
 	int total = 0;
@@ -154,8 +192,8 @@ struct appInfoStruct {
 	bool isSystemApp;              // 是否系统应用
 	time_t startRunningTime = 0;   // 某次开始运行时刻
 	time_t totalRunningTime = 0;   // 运行时长
-	string package;                // 包名
-	string label;                  // 名称
+	istr package;                  // 包名
+	istr label;                    // 名称
 	vector<int> pids;              // PID列表
 };
 
@@ -164,6 +202,37 @@ struct cfgStruct {
 	bool isTolerant = true;
 };
 
+// 固定模板的日志以二进制事件记录存入日志缓冲区, 客户端读取时才渲染成文本
+enum class EVENT : uint8_t {
+	FREEZE = 1,         // 冻结   pidCnt:进程数 duration:本次运行(秒) value:累计运行(秒) code:FREEZE_MODE
+	CLOSE = 2,          // 关闭   duration:本次运行(秒) value:累计运行(秒)
+	THAW = 3,           // 解冻   pidCnt:进程数
+	OPEN = 4,           // 打开
+	BINDER_DELAY = 5,   // Binder正在传输, 延迟冻结  duration:延迟(秒) value:PID
+	TIMED_THAW = 6,     // 定时解冻  pidCnt:进程数
+	KILLED_BACK = 7,    // 后台被杀
+	REFREEZE_FREEZER = 8,  // 定时Freezer压制  pidCnt:进程数
+	REFREEZE_SIGNAL = 9,   // 定时kill压制     pidCnt:进程数
+	REFREEZE_KILL = 10,    // 定时压制 杀死后台 pidCnt:进程数
+	BATTERY = 11,       // 电量变化 uid:上次电量 pidCnt:当前电量 duration:间隔(秒) value:功率(mW) code:温度(0.1℃)
+};
+
+constexpr uint8_t EVENT_TAG = 0x1E; // 事件记录首字节, 文本行总以 '[' 或 '\n' 开头
+
+#pragma pack(push, 1)
+struct eventRecord {
+	uint8_t tag = EVENT_TAG;
+	EVENT type;
+	uint16_t pidCnt;
+	uint32_t timestamp;
+	int32_t uid;
+	int32_t duration;
+	int32_t value;
+	int32_t code;      // 错误码/附加值
+};
+#pragma pack(pop)
+static_assert(sizeof(eventRecord) == 24);
+
 template<size_t N=16>
 class stackString {
 public:
@@ -311,9 +380,18 @@ namespace Utils {
 
 	// 最大读取 64 KiB
 	string readString(const char* path) {
-		char buff[64 * 1024];
-		readString(path, buff, sizeof(buff));
-		return string(buff);
+		constexpr size_t MAX_LEN = 64 * 1024;
+		string res;
+		auto fd = open(path, O_RDONLY);
+		if (fd <= 0) return res;
+
+		char buff[4096];
+		ssize_t len;
+		while (res.length() < MAX_LEN &&
+			(len = read(fd, buff, std::min(sizeof(buff), MAX_LEN - res.length()))) > 0)
+			res.append(buff, len);
+		close(fd);
+		return res;
 	}
 
 	bool writeInt(const char* path, const int value) {
@@ -337,6 +415,85 @@ namespace Utils {
 		return true;
 	}
 
+	constexpr uint32_t fnv1a(const char* str, const size_t len, uint32_t hash = 2166136261u) {
+		for (size_t i = 0; i < len; i++) {
+			hash ^= static_cast<uint8_t>(str[i]);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	constexpr uint32_t siteHash(const char* file, const int line) {
+		size_t len = 0;
+		while (file[len]) len++;
+		const uint32_t hash = fnv1a(file, len);
+		return (hash ^ static_cast<uint32_t>(line)) * 16777619u;
+	}
+
+	// CRC32C (Castagnoli, 反射多项式 0x82F63B78), 运行时检测 ARMv8 CRC / SSE4.2 指令, 不支持则查表
+	struct crc32cTableStruct {
+		uint32_t data[256]{};
+		constexpr crc32cTableStruct() {
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t crc = i;
+				for (int k = 0; k < 8; k++)
+					crc = (crc >> 1) ^ ((crc & 1) ? 0x82F63B78u : 0);
+				data[i] = crc;
+			}
+		}
+	};
+	inline constexpr crc32cTableStruct crc32cTable;
+
+	inline uint32_t crc32cSoft(uint32_t crc, const uint8_t* ptr, size_t len) {
+		while (len--)
+			crc = crc32cTable.data[(crc ^ *ptr++) & 0xff] ^ (crc >> 8);
+		return crc;
+	}
+
+#if defined(__aarch64__)
+	// 汇编指令自带扩展声明, 无需 -march=armv8-a+crc 编译选项
+	inline uint32_t crc32cHard(uint32_t crc, const uint8_t* ptr, size_t len) {
+		for (; len >= 8; len -= 8, ptr += 8) {
+			uint64_t value;
+			memcpy(&value, ptr, 8);
+			asm(".arch_extension crc\n\tcrc32cx %w[c], %w[c], %x[v]" : [c] "+r"(crc) : [v] "r"(value));
+		}
+		for (; len; len--, ptr++) {
+			const uint32_t value = *ptr;
+			asm(".arch_extension crc\n\tcrc32cb %w[c], %w[c], %w[v]" : [c] "+r"(crc) : [v] "r"(value));
+		}
+		return crc;
+	}
+
+	inline bool isCrc32cHard() { return getauxval(AT_HWCAP) & HWCAP_CRC32; }
+#elif defined(__x86_64__)
+	__attribute__((target("sse4.2")))
+	inline uint32_t crc32cHard(uint32_t crc, const uint8_t* ptr, size_t len) {
+		uint64_t crc64 = crc;
+		for (; len >= 8; len -= 8, ptr += 8) {
+			uint64_t value;
+			memcpy(&value, ptr, 8);
+			crc64 = _mm_crc32_u64(crc64, value);
+		}
+		crc = static_cast<uint32_t>(crc64);
+		for (; len; len--, ptr++)
+			crc = _mm_crc32_u8(crc, *ptr);
+		return crc;
+	}
+
+	inline bool isCrc32cHard() { return __builtin_cpu_supports("sse4.2"); }
+#else
+	inline uint32_t crc32cHard(uint32_t crc, const uint8_t* ptr, size_t len) { return crc32cSoft(crc, ptr, len); }
+	inline bool isCrc32cHard() { return false; }
+#endif
+
+	// crc: 上一段的结果, 可分段连续计算
+	inline uint32_t crc32c(const void* data, const size_t len, const uint32_t crc = 0) {
+		static const bool isHard = isCrc32cHard();
+		const auto ptr = static_cast<const uint8_t*>(data);
+		return ~(isHard ? crc32cHard(~crc, ptr, len) : crc32cSoft(~crc, ptr, len));
+	}
+
 	char lastChar(char* ptr) {
 		if (!ptr)return 0;
 		while (*ptr) ptr++;
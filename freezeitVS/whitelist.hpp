@@ -0,0 +1,537 @@
+#pragma once
+
+#include "utils.hpp"
+
+// 内置白名单与系统应用前缀, 均在编译期生成查找表, 位于只读数据段, 查找不分配内存
+namespace Whitelist {
+
+	// 每次混合8字节(小端), 编译期逐字节拼接, 运行期直接读取, 两者结果一致
+	constexpr uint64_t hashString(const std::string_view str) {
+		uint64_t hash = 0xcbf29ce484222325ULL ^ str.length();
+		for (size_t i = 0; i < str.length(); i += 8) {
+			const size_t len = std::min<size_t>(8, str.length() - i);
+			uint64_t word = 0;
+			if (len == 8 && !std::is_constant_evaluated())
+				memcpy(&word, str.data() + i, 8);
+			else {
+				for (size_t k = 0; k < len; k++)
+					word |= static_cast<uint64_t>(static_cast<uint8_t>(str[i + k])) << (k * 8);
+			}
+			hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+			hash ^= hash >> 29;
+		}
+		return hash;
+	}
+
+	// 以种子再混合, 用于第二级定位
+	constexpr uint64_t mixSeed(uint64_t hash, const uint32_t seed) {
+		hash ^= seed * 0x9E3779B97F4A7C15ULL;
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	// 完美哈希集合 (hash and displace): 键先按哈希分桶, 每个桶找一个种子,
+	// 使桶内各键经 mixSeed 后落在互不冲突的空槽位, 查找只需一次哈希 一次混合 一次比较
+	template<size_t N>
+	class perfectHashSet {
+	private:
+		constexpr static size_t SLOT_CNT = std::bit_ceil(N * 3);
+		constexpr static size_t BUCKET_CNT = N / 2 + 1;
+		constexpr static size_t BUCKET_SIZE_MAX = 16;
+
+		std::array<std::string_view, N> keys{};
+		std::array<uint16_t, SLOT_CNT> slots{};    // 键下标+1, 0:空
+		std::array<uint16_t, BUCKET_CNT> seeds{};
+		bool isBuilt = false;
+
+		// 为一个桶找种子, 桶内重复的键只占一个槽位
+		constexpr bool placeBucket(const std::array<uint64_t, N>& hashes, const size_t* member,
+			const size_t memberCnt) {
+			for (uint32_t seed = 1; seed < 0xFFFF; seed++) {
+				size_t slotTmp[BUCKET_SIZE_MAX]{};
+				bool isOk = true;
+				for (size_t i = 0; i < memberCnt && isOk; i++) {
+					slotTmp[i] = mixSeed(hashes[member[i]], seed) & (SLOT_CNT - 1);
+					if (slots[slotTmp[i]]) isOk = false;
+					for (size_t j = 0; j < i && isOk; j++) {
+						if (slotTmp[j] == slotTmp[i] && keys[member[j]] != keys[member[i]])
+							isOk = false;
+					}
+				}
+				if (!isOk) continue;
+
+				for (size_t i = 0; i < memberCnt; i++)
+					slots[slotTmp[i]] = static_cast<uint16_t>(member[i] + 1);
+				seeds[hashes[member[0]] % BUCKET_CNT] = static_cast<uint16_t>(seed);
+				return true;
+			}
+			return false;
+		}
+
+	public:
+		constexpr explicit perfectHashSet(const std::string_view(&list)[N]) {
+			std::array<uint64_t, N> hashes{};
+			std::array<size_t, BUCKET_CNT + 1> bucketBegin{};
+			for (size_t i = 0; i < N; i++) {
+				keys[i] = list[i];
+				hashes[i] = hashString(list[i]);
+				bucketBegin[hashes[i] % BUCKET_CNT + 1]++;
+			}
+
+			// 按桶排列键下标(计数排序), 桶 b 的成员为 member[bucketBegin[b], bucketBegin[b+1])
+			for (size_t bucket = 0; bucket < BUCKET_CNT; bucket++) {
+				if (bucketBegin[bucket + 1] > BUCKET_SIZE_MAX) return;
+				bucketBegin[bucket + 1] += bucketBegin[bucket];
+			}
+			std::array<size_t, N> member{};
+			std::array<size_t, BUCKET_CNT> fillCnt{};
+			for (size_t i = 0; i < N; i++) {
+				const size_t bucket = hashes[i] % BUCKET_CNT;
+				member[bucketBegin[bucket] + fillCnt[bucket]++] = i;
+			}
+
+			// 大桶先放, 此时空槽位多, 容易找到种子
+			for (size_t size = BUCKET_SIZE_MAX; size > 0; size--) {
+				for (size_t bucket = 0; bucket < BUCKET_CNT; bucket++) {
+					if (bucketBegin[bucket + 1] - bucketBegin[bucket] != size) continue;
+					if (!placeBucket(hashes, member.data() + bucketBegin[bucket], size)) return;
+				}
+			}
+			isBuilt = true;
+		}
+
+		constexpr bool isValid() const { return isBuilt; }
+
+		constexpr bool contains(const std::string_view str) const {
+			const uint64_t hash = hashString(str);
+			const uint16_t idx = slots[mixSeed(hash, seeds[hash % BUCKET_CNT]) & (SLOT_CNT - 1)];
+			return idx && keys[idx - 1] == str;
+		}
+	};
+
+	template<size_t N>
+	constexpr size_t totalLength(const std::string_view(&list)[N]) {
+		size_t len = 0;
+		for (const auto& str : list) len += str.length();
+		return len;
+	}
+
+	// 前缀字典树: 子节点以兄弟链表相连, 逐字符下降, 到达任一前缀的末尾即匹配
+	template<size_t NODE_MAX>
+	class prefixTrie {
+	private:
+		struct node {
+			char ch = 0;
+			bool isEnd = false;
+			uint16_t child = 0;   // 0:无 (根节点不会是子节点)
+			uint16_t sibling = 0;
+		};
+		std::array<node, NODE_MAX> nodes{};
+		size_t nodeCnt = 1;
+
+		constexpr uint16_t findChild(const uint16_t parent, const char ch) const {
+			for (uint16_t idx = nodes[parent].child; idx; idx = nodes[idx].sibling)
+				if (nodes[idx].ch == ch) return idx;
+			return 0;
+		}
+
+	public:
+		template<size_t N>
+		constexpr explicit prefixTrie(const std::string_view(&list)[N]) {
+			for (const auto& prefix : list) {
+				uint16_t cur = 0;
+				for (const char ch : prefix) {
+					uint16_t next = findChild(cur, ch);
+					if (!next) {
+						next = static_cast<uint16_t>(nodeCnt++);
+						nodes[next].ch = ch;
+						nodes[next].sibling = nodes[cur].child;
+						nodes[cur].child = next;
+					}
+					cur = next;
+				}
+				nodes[cur].isEnd = true;
+			}
+		}
+
+		constexpr bool matchPrefix(const std::string_view str) const {
+			uint16_t cur = 0;
+			for (const char ch : str) {
+				cur = findChild(cur, ch);
+				if (!cur) return false;
+				if (nodes[cur].isEnd) return true;
+			}
+			return false;
+		}
+	};
+
+	// 强制白名单, 配置无法更改
+	inline constexpr std::string_view FORCE_LIST[] = {
+		"com.xiaomi.mibrain.speech",            // 系统语音引擎
+		"com.xiaomi.scanner",                   // 小爱视觉
+		"com.xiaomi.xmsf",                      // Push
+		"com.xiaomi.xmsfkeeper",                // Push
+		"com.xiaomi.misettings",                // 设置
+		"com.xiaomi.barrage",                   // 弹幕通知
+		"com xiaomi.aireco",                    // 小爱建议
+		"com.xiaomi.account",                   // 小米账号
+		"com.mfashiongallery.emag",             // 小米画报
+		"com.huawei.hwid",                      // HMS core服务
+
+		"cn.litiaotiao.app",                    // 李跳跳
+		"com.litiaotiao.app",                   // 李跳跳
+		"hello.litiaotiao.app",                 // 李跳跳
+		"com.topjohnwu.magisk",                 // Magisk
+		"io.github.vvb2060.magisk",             // Magisk Alpha
+		"io.github.huskydg.magisk",             // Magisk Delta
+		"io.github.jark006.freezeit",           // 冻它
+		"io.github.jark006.weather",            // 小天气
+		"com.jark006.weather",                  // 小天气
+		"org.lsposed.manager",                  // LSPosed
+		"com.github.tianma8023.xposed.smscode", // XposedSmsCode
+		"com.merxury.blocker",                  // Blocker
+		"com.wpengapp.lightstart",              // 轻启动
+		"name.monwf.customiuizer",              // 米客 原版
+		"name.mikanoshi.customiuizer",          // 米客
+
+		"org.meowcat.xposed.mipush",            // 小米推送框架增强
+		"top.trumeet.mipush",                   // 小米推送服务
+		"one.yufz.hmspush",                     // HMSPush服务
+
+		"app.lawnchair",                        // Lawnchair
+		"com.microsoft.launcher",               // 微软桌面
+		"com.teslacoilsw.launcher",             // Nova Launcher
+		"com.hola.launcher",                    // Hola桌面
+		"com.transsion.XOSLauncher",            // XOS桌面
+		"com.mi.android.globallauncher",        // POCO桌面
+		"com.gau.go.launcherex",                // GO桌面
+		"bitpit.launcher",                      // Niagara Launcher
+		"com.google.android.apps.nexuslauncher",// pixel 桌面
+		"com.oppo.launcher",
+
+		"me.weishu.kernelsu",                   // KernelSU
+		"top.canyie.dreamland.manager",         // Dreamland
+
+		"com.miui.home",
+		"com.miui.carlink",
+		"com.miui.packageinstaller",            // 安装包管理
+		"com.coloros.packageinstaller",         // 安装包管理
+		"com.oplus.packageinstaller",           // 安装包管理
+		"com.iqoo.packageinstaller",            // 安装包管理
+		"com.vivo.packageinstaller",            // 安装包管理
+		"com.google.android.packageinstaller",  // 软件包安装程序
+
+
+		"com.baidu.input",                            //百度输入法
+		"com.baidu.input_huawei",                     //百度输入法华为版
+		"com.baidu.input_mi",                         //百度输入法小米版
+		"com.baidu.input_oppo",                       //百度输入法OPPO版
+		"com.baidu.input_vivo",                       //百度输入法VIVO版
+		"com.baidu.input_yijia",                      //百度输入法一加版
+
+		"com.sohu.inputmethod.sogou",                 //搜狗输入法
+		"com.sohu.inputmethod.sogou.xiaomi",          //搜狗输入法小米版
+		"com.sohu.inputmethod.sogou.meizu",           //搜狗输入法魅族版
+		"com.sohu.inputmethod.sogou.nubia",           //搜狗输入法nubia版
+		"com.sohu.inputmethod.sogou.chuizi",          //搜狗输入法chuizi版
+		"com.sohu.inputmethod.sogou.moto",            //搜狗输入法moto版
+		"com.sohu.inputmethod.sogou.zte",             //搜狗输入法中兴版
+		"com.sohu.inputmethod.sogou.samsung",         //搜狗输入法samsung版
+		"com.sohu.input_yijia",                       //搜狗输入法一加版
+
+		"com.iflytek.inputmethod",                    //讯飞输入法
+		"com.iflytek.inputmethod.miui",               //讯飞输入法小米版
+		"com.iflytek.inputmethod.googleplay",         //讯飞输入法googleplay版
+		"com.iflytek.inputmethod.smartisan",          //讯飞输入法smartisan版
+		"com.iflytek.inputmethod.oppo",               //讯飞输入法oppo版
+		"com.iflytek.inputmethod.oem",                //讯飞输入法oem版
+		"com.iflytek.inputmethod.custom",             //讯飞输入法custom版
+		"com.iflytek.inputmethod.blackshark",         //讯飞输入法blackshark版
+		"com.iflytek.inputmethod.zte",                //讯飞输入法zte版
+
+		"com.tencent.qqpinyin",                       // QQ拼音输入法
+		"com.google.android.inputmethod.latin",       //谷歌Gboard输入法
+		"com.touchtype.swiftkey",                     //微软swiftkey输入法
+		"com.touchtype.swiftkey.beta",                //微软swiftkeyBeta输入法
+		"im.weshine.keyboard",                        // KK键盘输入法
+		"com.komoxo.octopusime",                      //章鱼输入法
+		"com.qujianpan.duoduo",                       //见萌输入法
+		"com.lxlm.lhl.softkeyboard",                  //流行输入法
+		"com.jinkey.unfoldedime",                     //不折叠输入法
+		"com.iflytek.inputmethods.DungkarIME",        //东噶藏文输入法
+		"com.oyun.qingcheng",                         //奥云蒙古文输入法
+		"com.ziipin.softkeyboard",                    // Badam维语输入法
+		"com.kongzue.secretinput",                    // 密码键盘
+
+
+		"com.google.android.ext.services",
+		"com.google.android.ext.shared",
+
+		"com.android.launcher",
+		"com.android.launcher2",
+		"com.android.launcher3",
+		"com.android.launcher4",
+		"com.android.apps.tag", // Tags
+		"com.android.bips", // 系统打印服务
+		"com.android.bluetoothmidiservice", // Bluetooth MIDI Service
+		"com.android.cameraextensions", // CameraExtensionsProxy
+		"com.android.captiveportallogin", // CaptivePortalLogin
+		"com.android.carrierdefaultapp", // 运营商默认应用
+		"com.android.certinstaller", // 证书安装程序
+		"com.android.companiondevicemanager", // 配套设备管理器
+		"com.android.connectivity.resources", // 系统网络连接资源
+		"com.android.contacts", // 通讯录与拨号
+		"com.android.deskclock", // 时钟
+		"com.android.dreams.basic", // 基本互动屏保
+		"com.android.egg", // Android S Easter Egg
+		"com.android.emergency", // 急救信息
+		"com.android.externalstorage", // 外部存储设备
+		"com.android.hotspot2.osulogin", // OsuLogin
+		"com.android.htmlviewer", // HTML 查看器
+		"com.android.incallui", // 电话
+		"com.android.internal.display.cutout.emulation.corner", // 边角刘海屏
+		"com.android.internal.display.cutout.emulation.double", // 双刘海屏
+		"com.android.internal.display.cutout.emulation.hole", // 打孔屏
+		"com.android.internal.display.cutout.emulation.tall", // 长型刘海屏
+		"com.android.internal.display.cutout.emulation.waterfall", // 瀑布刘海屏
+		"com.android.internal.systemui.navbar.gestural", // Gestural Navigation Bar
+		"com.android.internal.systemui.navbar.gestural_extra_wide_back", // Gestural Navigation Bar
+		"com.android.internal.systemui.navbar.gestural_narrow_back", // Gestural Navigation Bar
+		"com.android.internal.systemui.navbar.gestural_wide_back", // Gestural Navigation Bar
+		"com.android.internal.systemui.navbar.threebutton", // 3 Button Navigation Bar
+		"com.android.managedprovisioning", // 工作设置
+		"com.android.mms", // 短信
+		"com.android.modulemetadata", // Module Metadata
+		"com.android.mtp", // MTP 主机
+		"com.android.musicfx", // MusicFX
+		"com.android.networkstack.inprocess.overlay", // NetworkStackInProcessResOverlay
+		"com.android.networkstack.overlay", // NetworkStackOverlay
+		"com.android.networkstack.tethering.inprocess.overlay", // TetheringResOverlay
+		"com.android.networkstack.tethering.overlay", // TetheringResOverlay
+		"com.android.packageinstaller", // 软件包安装程序
+		"com.android.pacprocessor", // PacProcessor
+		"com.android.permissioncontroller", // 权限控制器
+		"com.android.printspooler", // 打印处理服务
+		"com.android.providers.calendar", // 日历存储
+		"com.android.providers.contacts", // 联系人存储
+		"com.android.providers.downloads.ui", // 下载管理
+		"com.android.providers.media.module", // 媒体存储设备
+		"com.android.proxyhandler", // ProxyHandler
+		"com.android.server.telecom.overlay.miui", // 通话管理
+		"com.android.settings.intelligence", // 设置建议
+		"com.android.simappdialog", // Sim App Dialog
+		"com.android.soundrecorder", // 录音机
+		"com.android.statementservice", // 意图过滤器验证服务
+		"com.android.storagemanager", // 存储空间管理器
+		"com.android.theme.font.notoserifsource", // Noto Serif / Source Sans Pro
+		"com.android.traceur", // 系统跟踪
+		"com.android.uwb.resources", // System UWB Resources
+		"com.android.vpndialogs", // VpnDialogs
+		"com.android.wallpaper.livepicker", // Live Wallpaper Picker
+		"com.android.wifi.resources", // 系统 WLAN 资源
+		"com.debug.loggerui", // DebugLoggerUI
+		"com.fingerprints.sensortesttool", // Sensor Test Tool
+		"com.lbe.security.miui", // 权限管理服务
+		"com.mediatek.callrecorder", // 通话录音机
+		"com.mediatek.duraspeed", // 快霸
+		"com.mediatek.engineermode", // EngineerMode
+		"com.mediatek.lbs.em2.ui", // LocationEM2
+		"com.mediatek.location.mtkgeofence", // Mtk Geofence
+		"com.mediatek.mdmconfig", // MDMConfig
+		"com.mediatek.mdmlsample", // MDMLSample
+		"com.mediatek.miravision.ui", // MiraVision
+		"com.mediatek.op01.telecom", // OP01Telecom
+		"com.mediatek.op09clib.phone.plugin", // OP09ClibTeleService
+		"com.mediatek.op09clib.telecom", // OP09ClibTelecom
+		"com.mediatek.ygps", // YGPS
+		"com.miui.accessibility", // 小米无障碍
+		"com.miui.core", // MIUI SDK
+		"com.miui.privacycomputing", // MIUI Privacy Components
+		"com.miui.securityadd", // 系统服务组件
+		"com.miui.securityinputmethod", // 小米安全键盘
+		"com.miui.system", // com.miui.internal.app.SystemApplication
+		"com.miui.vpnsdkmanager", // MiuiVpnSdkManager
+		"com.tencent.soter.soterserver", // SoterService
+		"com.unionpay.tsmservice.mi", // 银联可信服务安全组件小米版本
+
+
+		"android.ext.services", // Android Services Library
+		"android.ext.shared", // Android Shared Library
+		"com.android.adservices.api", // Android AdServices
+		"com.android.bookmarkprovider", // Bookmark Provider
+		"com.android.cellbroadcastreceiver.module", // 无线紧急警报
+		"com.android.dialer", // 电话
+		"com.android.dreams.phototable", // 照片屏幕保护程序
+		"com.android.inputmethod.latin", // Android 键盘 (AOSP)
+		"com.android.intentresolver", // IntentResolver
+		"com.android.internal.display.cutout.emulation.noCutout", // 隐藏
+		"com.android.internal.systemui.navbar.twobutton", // 2 Button Navigation Bar
+		"com.android.messaging", // 短信
+		"com.android.onetimeinitializer", // One Time Init
+		"com.android.printservice.recommendation", // Print Service Recommendation Service
+		"com.android.safetycenter.resources", // 安全中心资源
+		"com.android.soundpicker", // 声音
+		"com.android.systemui", // 系统界面
+		"com.android.wallpaper", // 壁纸和样式
+		"com.qualcomm.qti.cne", // CneApp
+		"com.qualcomm.qti.poweroffalarm", // 关机闹钟
+		"com.qualcomm.wfd.service", // Wfd Service
+		"org.lineageos.aperture", // 相机
+		"org.lineageos.audiofx", // AudioFX
+		"org.lineageos.backgrounds", // 壁纸
+		"org.lineageos.customization", // Lineage Themes
+		"org.lineageos.eleven", // 音乐
+		"org.lineageos.etar", // 日历
+		"org.lineageos.jelly", // 浏览器
+		"org.lineageos.overlay.customization.blacktheme", // Black theme
+		"org.lineageos.overlay.font.lato", // Lato
+		"org.lineageos.overlay.font.rubik", // Rubik
+		"org.lineageos.profiles", // 情景模式信任提供器
+		"org.lineageos.recorder", // 录音机
+		"org.lineageos.updater", // 系统更新
+		"org.protonaosp.deviceconfig", // Simple Device Configuration
+
+		"android.aosp.overlay",
+		"android.miui.home.launcher.res",
+		"android.miui.overlay",
+		"com.android.carrierconfig",
+		"com.android.carrierconfig.overlay.miui",
+		"com.android.incallui.overlay",
+		"com.android.managedprovisioning.overlay",
+		"com.android.ondevicepersonalization.services",
+		"com.android.overlay.cngmstelecomm",
+		"com.android.overlay.gmscontactprovider",
+		"com.android.overlay.gmssettingprovider",
+		"com.android.overlay.gmssettings",
+		"com.android.overlay.gmstelecomm",
+		"com.android.overlay.gmstelephony",
+		"com.android.overlay.systemui",
+		"com.android.phone.overlay.miui",
+		"com.android.providers.settings.overlay",
+		"com.android.sdksandbox",
+		"com.android.settings.overlay.miui",
+		"com.android.stk.overlay.miui",
+		"com.android.systemui.gesture.line.overlay",
+		"com.android.systemui.navigation.bar.overlay",
+		"com.android.systemui.overlay.miui",
+		"com.android.wallpapercropper",
+		"com.android.wallpaperpicker",
+		"com.android.wifi.dialog",
+		"com.android.wifi.resources.overlay",
+		"com.android.wifi.resources.xiaomi",
+		"com.android.wifi.system.mainline.resources.overlay",
+		"com.android.wifi.system.resources.overlay",
+		"com.google.android.cellbroadcastreceiver.overlay.miui",
+		"com.google.android.cellbroadcastservice.overlay.miui",
+		"com.google.android.overlay.gmsconfig",
+		"com.google.android.overlay.modules.ext.services",
+		"com.google.android.trichromelibrary_511209734",
+		"com.google.android.trichromelibrary_541411734",
+		"com.mediatek.FrameworkResOverlayExt",
+		"com.mediatek.SettingsProviderResOverlay",
+		"com.mediatek.batterywarning",
+		"com.mediatek.cellbroadcastuiresoverlay",
+		"com.mediatek.frameworkresoverlay",
+		"com.mediatek.gbaservice",
+		"com.mediatek.voiceunlock",
+		"com.miui.core.internal.services",
+		"com.miui.face.overlay.miui",
+		"com.miui.miwallpaper.overlay.customize",
+		"com.miui.miwallpaper.wallpaperoverlay.config.overlay",
+		"com.miui.rom",
+		"com.miui.settings.rro.device.config.overlay",
+		"com.miui.settings.rro.device.hide.statusbar.overlay",
+		"com.miui.settings.rro.device.type.overlay",
+		"com.miui.system.overlay",
+		"com.miui.systemui.carriers.overlay",
+		"com.miui.systemui.devices.overlay",
+		"com.miui.systemui.overlay.devices.android",
+		"com.miui.translation.kingsoft",
+		"com.miui.translation.xmcloud",
+		"com.miui.translationservice",
+		"com.miui.voiceassistoverlay",
+		"com.miui.wallpaper.overlay.customize",
+		"com.xiaomi.bluetooth.rro.device.config.overlay",
+
+
+		"android.auto_generated_rro_product__",
+		"android.auto_generated_rro_vendor__",
+		"com.android.backupconfirm",
+		"com.android.carrierconfig.auto_generated_rro_vendor__",
+		"com.android.cts.ctsshim",
+		"com.android.cts.priv.ctsshim",
+		"com.android.documentsui.auto_generated_rro_product__",
+		"com.android.emergency.auto_generated_rro_product__",
+		"com.android.imsserviceentitlement",
+		"com.android.imsserviceentitlement.auto_generated_rro_product__",
+		"com.android.inputmethod.latin.auto_generated_rro_product__",
+		"com.android.launcher3.overlay",
+		"com.android.managedprovisioning.auto_generated_rro_product__",
+		"com.android.nearby.halfsheet",
+		"com.android.phone.auto_generated_rro_vendor__",
+		"com.android.providers.settings.auto_generated_rro_product__",
+		"com.android.providers.settings.auto_generated_rro_vendor__",
+		"com.android.settings.auto_generated_rro_product__",
+		"com.android.sharedstoragebackup",
+		"com.android.smspush",
+		"com.android.storagemanager.auto_generated_rro_product__",
+		"com.android.systemui.auto_generated_rro_product__",
+		"com.android.systemui.auto_generated_rro_vendor__",
+		"com.android.systemui.plugin.globalactions.wallet",
+		"com.android.wallpaper.auto_generated_rro_product__",
+		"com.android.wifi.resources.oneplus_sdm845",
+		"com.qualcomm.timeservice",
+		"lineageos.platform.auto_generated_rro_product__",
+		"lineageos.platform.auto_generated_rro_vendor__",
+		"org.codeaurora.ims",
+		"org.lineageos.aperture.auto_generated_rro_vendor__",
+		"org.lineageos.lineageparts.auto_generated_rro_product__",
+		"org.lineageos.lineagesettings.auto_generated_rro_product__",
+		"org.lineageos.lineagesettings.auto_generated_rro_vendor__",
+		"org.lineageos.overlay.customization.navbar.nohint",
+		"org.lineageos.settings.device.auto_generated_rro_product__",
+		"org.lineageos.settings.doze.auto_generated_rro_product__",
+		"org.lineageos.settings.doze.auto_generated_rro_vendor__",
+		"org.lineageos.setupwizard.auto_generated_rro_product__",
+		"org.lineageos.updater.auto_generated_rro_product__",
+		"org.protonaosp.deviceconfig.auto_generated_rro_product__",
+
+	};
+
+	// 默认白名单, 可在管理器更改
+	inline constexpr std::string_view DEFAULT_LIST[] = {
+		// "com.android.vending",                  // Play 商店
+		// "com.google.android.gms",               // GMS 服务
+		// "com.google.android.gsf",               // Google 服务框架
+		"com.mi.health",                        // 小米运动健康
+		"com.tencent.mm.wxa.sce",               // 微信小程序
+
+		"com.onlyone.onlyonestarter",           // 三星系应用
+		"com.samsung.accessory.neobeanmgr",     // Galaxy Buds Live Manager
+		"com.samsung.app.newtrim",              // 编辑器精简版
+		"com.diotek.sec.lookup.dictionary",     // 字典
+	};
+
+	// 系统应用包名前缀, 默认白名单
+	inline constexpr std::string_view SYSTEM_PREFIX[] = {
+		"com.miui.",
+		"com.oplus.",
+		"com.coloros.",
+		"com.heytap.",
+		"com.samsung.android.",
+		"com.samsung.systemui.",
+		"com.android.samsung.",
+		"com.sec.android.",
+	};
+
+	inline constexpr perfectHashSet forceSet(FORCE_LIST);
+	inline constexpr perfectHashSet defaultSet(DEFAULT_LIST);
+	inline constexpr prefixTrie<totalLength(SYSTEM_PREFIX) + 1> systemPrefix(SYSTEM_PREFIX);
+	static_assert(forceSet.isValid() && defaultSet.isValid(), "白名单完美哈希生成失败");
+
+	inline bool isForce(const std::string_view package) { return forceSet.contains(package); }
+	inline bool isDefault(const std::string_view package) { return defaultSet.contains(package); }
+	inline bool isSystemApp(const std::string_view package) { return systemPrefix.matchPrefix(package); }
+}